@@ -17,7 +17,7 @@ int attack::isSquareAttacked(int square, constants::Color player, board::BoardSt
 			return true;
 	}
 
-	for (int move : knight_dir) {
+	for (int move : constants::KNIGHT_DIRECTIONS) {
 		int piece = state.pieces[square + move];
 		if (piece == asInt(constants::Square::OFFBOARD))
 			continue;
@@ -26,7 +26,7 @@ int attack::isSquareAttacked(int square, constants::Color player, board::BoardSt
 			return state.pieces[square + move];
 	}
 
-	for (int move : rook_dir) {
+	for (int move : constants::ROOK_DIRECTIONS) {
 		int _square = square + move;
 		int piece = state.pieces[_square];
 
@@ -42,7 +42,7 @@ int attack::isSquareAttacked(int square, constants::Color player, board::BoardSt
 		}
 	}
 
-	for (int move : bishop_dir) {
+	for (int move : constants::BISHOP_DIRECTIONS) {
 		int _square = square + move;
 		int piece = state.pieces[_square];
 
@@ -59,7 +59,7 @@ int attack::isSquareAttacked(int square, constants::Color player, board::BoardSt
 	}
 
 
-	for (int move : king_dir) {
+	for (int move : constants::KING_DIRECTIONS) {
 		int piece = state.pieces[square + move];
 
 		if (piece == asInt(constants::Square::OFFBOARD))
@@ -70,4 +70,9 @@ int attack::isSquareAttacked(int square, constants::Color player, board::BoardSt
 	}
 
 	return false;
+}
+
+bool attack::isInCheck(board::BoardState& state) {
+	int king = state.player == constants::Color::WHITE ? asInt(constants::Piece::wK) : asInt(constants::Piece::bK);
+	return isSquareAttacked(state.piece_list[king][0], static_cast<constants::Color>(asInt(state.player) ^ 1), state);
 }
\ No newline at end of file
@@ -3,14 +3,39 @@
 #include <array>
 
 #include "board.hpp"
+#include "bitboard.hpp"
+#include "constants.hpp"
 
 namespace attack {
 
-	const std::array<int, 8> knight_dir = { -8, -19, -21, -12, 8, 19, 21, 12 };
-	const std::array<int, 4> rook_dir = { -1, -10, 1, 10 };
-	const std::array<int, 4> bishop_dir = { -9, -11, 11, 9 };
-	const std::array<int, 8> king_dir = { -1, -10, 1, 10, -9, -11, 11, 9};
+	// Squares of the 64 square board a piece on the square attacks on an empty board, for every piece that doesn't slide
+	constexpr std::array<bitboard::Bitboard, 64> generateAttacks(const constants::DirectionList& directions) {
+		std::array<bitboard::Bitboard, 64> result = {};
+
+		for (int square = 0; square < 64; square++) {
+			for (int direction : directions) {
+				// the 120 square board catches steps off the edge
+				int target = square + 21 + 2 * (square / 8) + direction;
+				int row = target / 10 - 2;
+				int col = target % 10 - 1;
+
+				if (row >= 0 && row < 8 && col >= 0 && col < 8)
+					result[square] |= 1ULL << (row * 8 + col);
+			}
+		}
+
+		return result;
+	}
+
+	constexpr std::array<bitboard::Bitboard, 64> KNIGHT_ATTACKS = generateAttacks(constants::KNIGHT_DIRECTIONS);
+	constexpr std::array<bitboard::Bitboard, 64> KING_ATTACKS = generateAttacks(constants::KING_DIRECTIONS);
+	// [color][square]
+	constexpr std::array<std::array<bitboard::Bitboard, 64>, 2> PAWN_ATTACKS = {
+		generateAttacks(constants::WHITE_PAWN_CAPTURES), generateAttacks(constants::BLACK_PAWN_CAPTURES)
+	};
 
 	int isSquareAttacked(int square, constants::Color player, board::BoardState& state);
+	// whether the king of the side to move is attacked
+	bool isInCheck(board::BoardState& state);
 
 }
\ No newline at end of file
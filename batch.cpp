@@ -0,0 +1,417 @@
+#ifndef WIN32
+#include <unistd.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <deque>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include "batch.hpp"
+#include "search.hpp"
+#include "constants.hpp"
+#include "util.hpp"
+#include "threadbinding.hpp"
+
+namespace batch {
+
+	constexpr size_t TABLE_SIZE = 1 << 20;
+	constexpr size_t EVAL_TABLE_SIZE = 1 << 18;
+
+	// One input stream. Its answers are written in one piece each, and the stream can wait until every position it sent is answered.
+	class Client {
+	public:
+		explicit Client(std::function<void(const std::string&)> write) : write(write), pending(0) {}
+
+		void submitted() {
+			std::lock_guard<std::mutex> lock(mutex);
+			pending++;
+		}
+
+		void answer(const std::string& line) {
+			std::lock_guard<std::mutex> lock(mutex);
+			write(line);
+			pending--;
+			answered.notify_all();
+		}
+
+		void waitForAnswers() {
+			std::unique_lock<std::mutex> lock(mutex);
+			answered.wait(lock, [this]() { return pending == 0; });
+		}
+
+	private:
+		std::function<void(const std::string&)> write;
+		std::mutex mutex;
+		std::condition_variable answered;
+		long pending;
+	};
+
+	struct Job {
+		std::string id;
+		std::string fen;
+		Limits limits;
+		std::shared_ptr<Client> client;
+	};
+
+	class WorkerPool {
+	public:
+		explicit WorkerPool(int threads) : done(false) {
+			for (int i = 0; i < threads; i++)
+				workers.emplace_back([this, i]() { work(i); });
+		}
+
+		// answers the jobs left in the queue before the workers end
+		~WorkerPool() {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				done = true;
+			}
+
+			available.notify_all();
+
+			for (auto& worker : workers)
+				worker.join();
+		}
+
+		void submit(Job job) {
+			job.client->submitted();
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				jobs.push_back(std::move(job));
+			}
+
+			available.notify_one();
+		}
+
+	private:
+		void work(int index);
+
+		std::mutex mutex;
+		std::condition_variable available;
+		std::deque<Job> jobs;
+		bool done;
+		std::vector<std::thread> workers;
+	};
+
+	static std::string escapeJson(const std::string& text) {
+		std::string escaped;
+
+		for (char c : text) {
+			if (c == '"' || c == '\\')
+				escaped += '\\';
+
+			if (static_cast<unsigned char>(c) >= ' ')
+				escaped += c;
+		}
+
+		return escaped;
+	}
+
+	static std::string scoreToJson(int score) {
+		if (std::abs(score) > constants::MATE - search::MAX_DEPTH) {
+			int moves = (constants::MATE - std::abs(score) + 1) / 2;
+			return "{\"mate\":" + std::to_string(score > 0 ? moves : -moves) + "}";
+		}
+
+		return "{\"cp\":" + std::to_string(score) + "}";
+	}
+
+	static std::string analyze(search::Searcher& searcher, board::BoardState& state, const Job& job) {
+		std::string answer = "{\"id\":\"" + escapeJson(job.id) + "\",\"fen\":\"" + escapeJson(job.fen) + "\"";
+
+		try {
+			state.loadFromFen(job.fen);
+		}
+		// stoi of the counters throws out_of_range as well
+		catch (const std::logic_error&) {
+			return answer + ",\"error\":\"invalid fen\"}";
+		}
+
+		// an unlimited depth needs another limit to end the search
+		bool bounded = job.limits.nodes > 0 || job.limits.movetime > 0;
+		searcher.depth = job.limits.depth > 0 ? job.limits.depth : bounded ? search::MAX_DEPTH : Limits().depth;
+		searcher.node_limit = job.limits.nodes;
+		searcher.timeset = job.limits.movetime > 0;
+		searcher.stopped = false;
+		searcher.start_time = util::getTimeInMs();
+		searcher.stop_time = searcher.start_time + job.limits.movetime;
+		searcher.think(state);
+
+		long time = util::getTimeInMs() - searcher.start_time;
+
+		if (searcher.root_moves.empty())
+			return answer + ",\"bestmove\":null,\"nodes\":0,\"time\":" + std::to_string(time) + "}";
+
+		const search::RootMove& best = searcher.root_moves[0];
+		int score = best.lastScore();
+
+		answer += ",\"bestmove\":\"" + best.move.toString() + "\"";
+
+		if (score != -constants::INFINITE_VAL)
+			answer += ",\"score\":" + scoreToJson(score);
+
+		answer += ",\"depth\":" + std::to_string(searcher.completed_depth) + ",\"pv\":[";
+
+		for (size_t i = 0; i < best.pv.size(); i++)
+			answer += (i ? ",\"" : "\"") + best.pv[i].toString() + "\"";
+
+		return answer + "],\"nodes\":" + std::to_string(searcher.nodes) + ",\"time\":" + std::to_string(time) + "}";
+	}
+
+	void WorkerPool::work(int index) {
+		threadbinding::bindThisThread(index);
+
+		search::Searcher searcher(TABLE_SIZE, EVAL_TABLE_SIZE, search::MAX_DEPTH);
+		board::BoardState state;
+		searcher.print_info = false;
+
+		while (true) {
+			Job job;
+
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				available.wait(lock, [this]() { return done || !jobs.empty(); });
+
+				if (jobs.empty())
+					return;
+
+				job = std::move(jobs.front());
+				jobs.pop_front();
+			}
+
+			job.client->answer(analyze(searcher, state, job));
+		}
+	}
+
+	// Turns one input line into a job, false for lines that aren't positions
+	static bool parseLine(const std::string& line, long line_number, const Limits& defaults, Job& job) {
+		std::istringstream stream(line);
+		std::vector<std::string> fen_fields;
+		std::string token;
+
+		job.id = std::to_string(line_number);
+		job.limits = defaults;
+
+		try {
+			while (stream >> token) {
+				if (token == "id") { stream >> job.id; }
+				else if (token == "fen") {}
+				else if (token == "startpos") { job.fen = constants::FEN_START_POS; }
+				else if (token == "depth") { stream >> token; job.limits.depth = std::stoi(token); }
+				else if (token == "nodes") { stream >> token; job.limits.nodes = std::stol(token); }
+				else if (token == "movetime") { stream >> token; job.limits.movetime = std::stol(token); }
+				// EPD operations like bm follow the four position fields
+				else if (fen_fields.size() < 6 && token.find(';') == std::string::npos) { fen_fields.push_back(token); }
+			}
+		}
+		// a number too large for its type is as invalid as one that isn't a number
+		catch (const std::logic_error&) {
+			return false;
+		}
+
+		if (job.fen.empty()) {
+			if (fen_fields.size() < 4)
+				return false;
+
+			bool has_counters = fen_fields.size() == 6 && std::isdigit(fen_fields[4][0]) && std::isdigit(fen_fields[5][0]);
+			job.fen = fen_fields[0] + " " + fen_fields[1] + " " + fen_fields[2] + " " + fen_fields[3] + (has_counters ? " " + fen_fields[4] + " " + fen_fields[5] : " 0 1");
+		}
+
+		return true;
+	}
+
+	// Submits every position line until end or the end of the input
+	static void readInput(std::function<bool(std::string&)> readLine, const std::shared_ptr<Client>& client, const Limits& defaults, WorkerPool& pool) {
+		std::string line;
+		long line_number = 0;
+
+		while (readLine(line)) {
+			line_number++;
+
+			if (!line.empty() && line.back() == '\r')
+				line.pop_back();
+
+			if (line == "end" || line == "quit")
+				return;
+
+			if (line.empty())
+				continue;
+
+			Job job;
+			job.client = client;
+
+			if (parseLine(line, line_number, defaults, job)) {
+				pool.submit(std::move(job));
+				continue;
+			}
+
+			client->submitted();
+			client->answer("{\"id\":\"" + std::to_string(line_number) + "\",\"error\":\"invalid input\"}");
+		}
+	}
+
+#ifndef WIN32
+	class SocketServer {
+	public:
+		SocketServer(const Options& options, WorkerPool& pool) : options(options), pool(pool), server(-1) {}
+
+		bool start() {
+			sockaddr_un address = {};
+			address.sun_family = AF_UNIX;
+
+			if (options.socket.size() >= sizeof(address.sun_path))
+				return false;
+
+			std::strcpy(address.sun_path, options.socket.c_str());
+			server = socket(AF_UNIX, SOCK_STREAM, 0);
+
+			// a socket file left by an earlier server would fail the bind
+			unlink(options.socket.c_str());
+
+			if (server < 0 || bind(server, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(server, 16) != 0)
+				return false;
+
+			accepting = std::thread([this]() { acceptClients(); });
+			return true;
+		}
+
+		// Stops accepting, ends the reading of every client and waits for their answers
+		void stop() {
+			if (server >= 0) {
+				shutdown(server, SHUT_RDWR);
+
+				if (accepting.joinable())
+					accepting.join();
+
+				close(server);
+				unlink(options.socket.c_str());
+				server = -1;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+
+				for (int fd : client_fds)
+					shutdown(fd, SHUT_RD);
+			}
+
+			for (auto& thread : client_threads)
+				thread.join();
+		}
+
+	private:
+		void acceptClients() {
+			int fd;
+
+			while ((fd = accept(server, nullptr, nullptr)) >= 0) {
+				std::lock_guard<std::mutex> lock(mutex);
+				client_fds.push_back(fd);
+				client_threads.emplace_back([this, fd]() { serveClient(fd); });
+			}
+		}
+
+		void serveClient(int fd) {
+			auto client = std::make_shared<Client>([fd](const std::string& line) {
+				std::string data = line + "\n";
+
+				// a client that hung up gets no more answers
+				for (size_t written = 0; written < data.size();) {
+					ssize_t count = write(fd, data.data() + written, data.size() - written);
+
+					if (count <= 0)
+						return;
+
+					written += count;
+				}
+			});
+
+			std::string buffer;
+			auto readLine = [fd, &buffer](std::string& line) {
+				size_t end;
+
+				while ((end = buffer.find('\n')) == std::string::npos) {
+					char chunk[4096];
+					ssize_t count = read(fd, chunk, sizeof(chunk));
+
+					if (count <= 0) {
+						line = buffer;
+						buffer.clear();
+						return !line.empty();
+					}
+
+					buffer.append(chunk, count);
+				}
+
+				line = buffer.substr(0, end);
+				buffer.erase(0, end + 1);
+				return true;
+			};
+
+			readInput(readLine, client, options.limits, pool);
+			client->waitForAnswers();
+
+			std::lock_guard<std::mutex> lock(mutex);
+			client_fds.erase(std::find(client_fds.begin(), client_fds.end(), fd));
+			close(fd);
+		}
+
+		const Options& options;
+		WorkerPool& pool;
+		int server;
+		std::thread accepting;
+		std::mutex mutex;
+		std::vector<int> client_fds;
+		std::vector<std::thread> client_threads;
+	};
+#endif
+
+	void run(const Options& options) {
+		WorkerPool pool(options.threads);
+		auto readStdin = [](std::string& line) { return static_cast<bool>(std::getline(std::cin, line)); };
+
+		if (options.socket.empty()) {
+			auto client = std::make_shared<Client>([](const std::string& line) { std::cout << line << std::endl; });
+			readInput(readStdin, client, options.limits, pool);
+			client->waitForAnswers();
+			return;
+		}
+
+#ifdef WIN32
+		std::cout << "info string batch sockets need a POSIX system" << std::endl;
+#else
+		// writing to a client that hung up must not end this process
+		signal(SIGPIPE, SIG_IGN);
+
+		SocketServer server(options, pool);
+
+		if (!server.start()) {
+			std::cout << "info string Could not listen on " << options.socket << std::endl;
+			server.stop();
+			return;
+		}
+
+		std::cout << "info string batch listening on " << options.socket << std::endl;
+
+		// stdin only ends the server
+		std::string line;
+
+		while (std::getline(std::cin, line) && line != "end" && line != "quit") {}
+
+		server.stop();
+#endif
+	}
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+
+namespace batch {
+
+	// Search limits of every position, a position line can override them
+	struct Limits {
+		int depth = 10;
+		long nodes = 0;
+		long movetime = 0; // ms
+	};
+
+	struct Options {
+		// workers, each with its own searcher and transposition table
+		int threads = 1;
+		Limits limits;
+		// serve clients on this Unix domain socket instead of reading stdin
+		std::string socket;
+	};
+
+	// Analyzes positions on a pool of workers. Each input line is one position,
+	//   [id <id>] [fen] <FEN or EPD> [depth n] [nodes n] [movetime ms]
+	// or startpos instead of the FEN, and is answered by one JSON line as soon as it is done, so answers can come out of order:
+	//   {"id":"7","fen":"...","bestmove":"e2e4","score":{"cp":31},"depth":10,"pv":["e2e4","e7e5"],"nodes":123456,"time":250}
+	// Without an id the answer carries the number of the input line. depth 0 lifts the depth limit when nodes or movetime
+	// bound the search, without them the default depth is used. Reading stops at "end" or the end of the input.
+	// With a socket, every client connection is an input of its own and is answered on the same connection,
+	// until "end" on stdin stops the server.
+	void run(const Options& options);
+
+}
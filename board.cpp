@@ -49,6 +49,7 @@ namespace board
           fifty_move(),
           ply(),
           his_ply(),
+          plies_from_null(),
           castle_permissions(),
           position_key(),
           piece_count(),
@@ -57,6 +58,8 @@ namespace board
           knights_bishops_count(),
           piece_keys(),
           material(),
+          psq_score(),
+          phase(),
           pv_array(),
           search_killers()
           
@@ -110,7 +113,7 @@ namespace board
 
             if (isdigit(c))
             {
-                index += atoi(&c);
+                index += c - '0';
                 continue;
             }
 
@@ -283,6 +286,55 @@ namespace board
         return s;
     }
 
+    std::string BoardState::toFen() const
+    {
+        const char *PIECE_CHARS = ".PNBRQKpnbrqk";
+        std::string fen;
+
+        for (int rank = asInt(constants::Rank::_8); rank >= asInt(constants::Rank::_1); --rank)
+        {
+            int empty = 0;
+
+            for (int file = asInt(constants::File::A); file <= asInt(constants::File::H); file++)
+            {
+                int piece = pieces[util::_120xyToSquare(file, rank)];
+
+                if (piece == asInt(constants::Piece::EMPTY))
+                {
+                    empty++;
+                    continue;
+                }
+
+                if (empty)
+                    fen += std::to_string(empty);
+
+                empty = 0;
+                fen += PIECE_CHARS[piece];
+            }
+
+            if (empty)
+                fen += std::to_string(empty);
+
+            if (rank != asInt(constants::Rank::_1))
+                fen += '/';
+        }
+
+        std::string castling;
+
+        if (castle_permissions & asInt(constants::Castle::wK)) castling += 'K';
+        if (castle_permissions & asInt(constants::Castle::wQ)) castling += 'Q';
+        if (castle_permissions & asInt(constants::Castle::bK)) castling += 'k';
+        if (castle_permissions & asInt(constants::Castle::bQ)) castling += 'q';
+
+        fen += player == constants::Color::WHITE ? " w " : " b ";
+        fen += castling.empty() ? "-" : castling;
+        fen += " ";
+        fen += en_passant == asInt(constants::Square::OFFBOARD) ? "-" : util::_120ToString(en_passant);
+        fen += " " + std::to_string(fifty_move) + " " + std::to_string(his_ply / 2 + 1);
+
+        return fen;
+    }
+
     void BoardState::generatePositionKey() {
         position_key = 0;
 
@@ -332,6 +384,9 @@ namespace board
             material[i] = 0;
         }
 
+        psq_score = 0;
+        phase = 0;
+
 
         for (int i = 0; i < 3; i++) {
             pawns[i] = 0;
@@ -342,8 +397,10 @@ namespace board
         fifty_move = 0;
         ply = 0;
         his_ply = 0;
+        plies_from_null = 0;
         castle_permissions = 0;
         position_key = 0;
+        undo_stack.clear();
 
     }
 
@@ -359,6 +416,8 @@ namespace board
                 if (constants::IS_ROOK_QUEEN_KING[piece]) rooks_queens_count[colour]++;
 
                 material[colour] += constants::PIECE_VALUE[piece];
+                psq_score += constants::PIECE_SQUARE_SCORE[piece][i];
+                phase += constants::PHASE_WEIGHT[piece];
 
                 piece_list[piece].push_back(i);
                 piece_count[piece]++;
@@ -381,6 +440,8 @@ namespace board
         std::array<int, 2> _knights_bishops_count = {};
         std::array<int, 2> _rooks_queens_count = {};
         std::array<int, 2> _material = {};
+        int _psq_score = 0;
+        int _phase = 0;
 
         std::array<bitboard::Bitboard, 3> _pawns = pawns;
 
@@ -406,6 +467,8 @@ namespace board
                 _knights_bishops_count[colour]++;
 
             _material[colour] += constants::PIECE_VALUE[_piece];
+            _psq_score += constants::PIECE_SQUARE_SCORE[_piece][_120];
+            _phase += constants::PHASE_WEIGHT[_piece];
    
         }
 
@@ -443,6 +506,9 @@ namespace board
         assert(_material[asInt(constants::Color::WHITE)] == material[asInt(constants::Color::WHITE)]);
         assert(_material[asInt(constants::Color::BLACK)] == material[asInt(constants::Color::BLACK)]);
 
+        assert(_psq_score == psq_score);
+        assert(_phase == phase);
+
         assert(_piece_count_no_pawns[asInt(constants::Color::WHITE)] == piece_count_no_pawns[asInt(constants::Color::WHITE)]);
         assert(_piece_count_no_pawns[asInt(constants::Color::BLACK)] == piece_count_no_pawns[asInt(constants::Color::BLACK)]);
 
@@ -496,6 +562,8 @@ namespace board
         piece_count[piece]--;
 
         material[color] -= constants::PIECE_VALUE[piece];
+        psq_score -= constants::PIECE_SQUARE_SCORE[piece][square];
+        phase -= constants::PHASE_WEIGHT[piece];
 
         assert(piece_count[piece] >= 0);
     
@@ -529,6 +597,8 @@ namespace board
         piece_count[asInt(piece)]++;
 
         material[color] += constants::PIECE_VALUE[asInt(piece)];
+        psq_score += constants::PIECE_SQUARE_SCORE[asInt(piece)][square];
+        phase += constants::PHASE_WEIGHT[asInt(piece)];
 
         pieces[square] = asInt(piece);
     }
@@ -544,6 +614,8 @@ namespace board
         position_key ^= piece_keys.piece_keys[piece][from];
         position_key ^= piece_keys.piece_keys[piece][to];
 
+        psq_score += constants::PIECE_SQUARE_SCORE[piece][to] - constants::PIECE_SQUARE_SCORE[piece][from];
+
         pieces[from] = asInt(constants::Piece::EMPTY);
         pieces[to] = piece;
 
@@ -615,6 +687,8 @@ namespace board
 
         // A bit slow because it copies the entire move class, may be subject to optimization
         undo_stack.back().move = move;
+        undo_stack.back().moved_piece = pieces[move.from];
+        undo_stack.back().plies_from_null = plies_from_null;
         undo_stack.back().fifty_move = fifty_move;
         undo_stack.back().en_passant = en_passant;
         undo_stack.back().castle_permissions = castle_permissions;
@@ -637,6 +711,7 @@ namespace board
 
         his_ply++;
         ply++;
+        plies_from_null++;
 
         if (!constants::IS_NOT_PAWN[pieces[move.from]]) {
             fifty_move = 0;
@@ -690,20 +765,24 @@ namespace board
 
         ply++;
         his_ply++;
-        position_key ^= piece_keys.side_key;
-        
-        undo_stack.push_back(UndoInfo());
-
-        if(en_passant != asInt(constants::Square::OFFBOARD)) {
-            position_key ^= piece_keys.piece_keys[asInt(constants::Piece::EMPTY)][en_passant];
-        }
-        en_passant = asInt(constants::Square::OFFBOARD);
 
+        // the undo information is the position before the null move
+        undo_stack.push_back(UndoInfo());
         undo_stack.back().move = move::Move();
+        undo_stack.back().moved_piece = asInt(constants::Piece::EMPTY);
+        undo_stack.back().plies_from_null = plies_from_null;
         undo_stack.back().fifty_move = fifty_move;
         undo_stack.back().en_passant = en_passant;
         undo_stack.back().castle_permissions = castle_permissions;
         undo_stack.back().position_key = position_key;
+
+        position_key ^= piece_keys.side_key;
+
+        if(en_passant != asInt(constants::Square::OFFBOARD)) {
+            position_key ^= piece_keys.piece_keys[asInt(constants::Piece::EMPTY)][en_passant];
+        }
+        en_passant = asInt(constants::Square::OFFBOARD);
+        plies_from_null = 0;
         
         player = static_cast<constants::Color>(asInt(player) ^ 1);
 
@@ -727,7 +806,7 @@ namespace board
         en_passant = info.en_passant;
         position_key = info.position_key;
         fifty_move = info.fifty_move;
-        position_key ^= piece_keys.side_key;
+        plies_from_null = info.plies_from_null;
 
         player = static_cast<constants::Color>(asInt(player) ^ 1);
 
@@ -750,6 +829,7 @@ namespace board
         castle_permissions = info.castle_permissions;
         fifty_move = info.fifty_move;
         en_passant = info.en_passant;
+        plies_from_null = info.plies_from_null;
 
         player = static_cast<constants::Color>(asInt(player) ^ 1);
 
@@ -801,11 +881,153 @@ namespace board
 
     }
 
+    // Plies to look back for a repetition: nothing before the last capture, pawn move or null move can repeat,
+    // and a position loaded from FEN has no history even if its fifty move counter isn't zero
+    static int repetitionWindow(const BoardState &state) {
+        return std::min({ state.fifty_move, state.plies_from_null, static_cast<int>(state.undo_stack.size()) });
+    }
+
     bool BoardState::isRepetition() const {
-        for (int i = his_ply - fifty_move; i < his_ply - 1; i++) {
-            const auto& info = undo_stack[i];
+        int window = repetitionWindow(*this);
+
+        // the same side is to move every second ply, and a position can't repeat within less than 4 plies
+        for (int i = 4; i <= window; i += 2) {
+            if (undo_stack[undo_stack.size() - i].position_key == position_key)
+                return true;
+        }
+
+        return false;
+    }
+
+    int BoardState::repetitionCount() const {
+        int window = repetitionWindow(*this);
+        int count = 0;
+
+        for (int i = 4; i <= window; i += 2) {
+            if (undo_stack[undo_stack.size() - i].position_key == position_key)
+                count++;
+        }
+
+        return count;
+    }
+
+    bool BoardState::isInsufficientMaterial() const {
+        int minors = 0;
+
+        for (int piece = asInt(constants::Piece::wP); piece <= asInt(constants::Piece::bK); piece++) {
+            if (constants::IS_KING[piece])
+                continue;
+
+            if (!constants::IS_KNIGHT_BISHOP[piece] && !piece_list[piece].empty())
+                return false;
+
+            minors += static_cast<int>(piece_list[piece].size());
+        }
+
+        return minors <= 1;
+    }
+
+    // Cuckoo tables of every reversible move: a non-pawn piece going between two squares it can reach
+    // on an empty board. The key of such a move is the XOR of the piece on both squares and the side key,
+    // so the difference between the current key and an earlier one can be looked up directly.
+    // See "Efficient detection of upcoming repetitions" by Marcel van Kervinck.
+    struct CuckooTables {
+        static constexpr int SIZE = 8192;
+
+        std::array<bitboard::Bitboard, SIZE> keys;
+        std::array<std::pair<int, int>, SIZE> moves;
+
+        static int hash1(bitboard::Bitboard key) { return key & 0x1FFF; }
+        static int hash2(bitboard::Bitboard key) { return (key >> 16) & 0x1FFF; }
+
+        CuckooTables() : keys(), moves() {
+            RandomPieceKeys piece_keys;
+            int count = 0;
+
+            for (int piece = asInt(constants::Piece::wN); piece <= asInt(constants::Piece::bK); piece++) {
+                if (!constants::IS_NOT_PAWN[piece])
+                    continue;
+
+                for (int from = 0; from < 64; from++) {
+                    for (int to = from + 1; to < 64; to++) {
+                        if (!reachesOnEmptyBoard(piece, from, to))
+                            continue;
+
+                        int square_from = util::_64To120(from);
+                        int square_to = util::_64To120(to);
+                        bitboard::Bitboard key = piece_keys.piece_keys[piece][square_from] ^ piece_keys.piece_keys[piece][square_to] ^ piece_keys.side_key;
+                        std::pair<int, int> move = { square_from, square_to };
+                        int index = hash1(key);
+
+                        // insert, kicking out the occupant to its other slot until an empty one is found
+                        while (true) {
+                            std::swap(keys[index], key);
+                            std::swap(moves[index], move);
+
+                            if (move.first == 0)
+                                break;
+
+                            index = index == hash1(key) ? hash2(key) : hash1(key);
+                        }
+
+                        count++;
+                    }
+                }
+            }
+
+            assert(count == 3668);
+        }
+
+        static bool reachesOnEmptyBoard(int piece, int from, int to) {
+            if (constants::IS_KNIGHT[piece])
+                return bitboard::hasBitAt(attack::KNIGHT_ATTACKS[from], to);
+            if (constants::IS_KING[piece])
+                return bitboard::hasBitAt(attack::KING_ATTACKS[from], to);
+
+            int direction = std::abs(constants::LINE_DIRECTION[from][to]);
+            bool straight = direction == 1 || direction == 10;
+            bool diagonal = direction == 9 || direction == 11;
+
+            return (constants::IS_ROOK_QUEEN[piece] && straight) || (constants::IS_BISHOP_QUEEN[piece] && diagonal);
+        }
+    };
+
+    static const CuckooTables cuckoo;
+
+    bool BoardState::hasUpcomingRepetition() const {
+        int window = repetitionWindow(*this);
+
+        for (int i = 3; i <= window; i += 2) {
+            bitboard::Bitboard move_key = position_key ^ undo_stack[undo_stack.size() - i].position_key;
+            int index = CuckooTables::hash1(move_key);
+
+            if (cuckoo.keys[index] != move_key) {
+                index = CuckooTables::hash2(move_key);
+
+                if (cuckoo.keys[index] != move_key)
+                    continue;
+            }
+
+            // only positions inside the search count, the game history is left to isRepetition
+            if (i >= ply)
+                continue;
+
+            int from = cuckoo.moves[index].first;
+            int to = cuckoo.moves[index].second;
+            int direction = constants::LINE_DIRECTION[util::_120To64(from)][util::_120To64(to)];
+            bool path_clear = true;
+
+            // knight jumps have no squares in between, any other move needs an empty path
+            if (direction) {
+                for (int square = from + direction; square != to; square += direction) {
+                    if (pieces[square] != asInt(constants::Piece::EMPTY)) {
+                        path_clear = false;
+                        break;
+                    }
+                }
+            }
 
-            if (info.position_key == position_key)
+            if (path_clear)
                 return true;
         }
 
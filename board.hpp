@@ -45,6 +45,8 @@ namespace board
         int castle_permissions;
         int en_passant;
         int fifty_move;
+        int moved_piece; // EMPTY for null moves
+        int plies_from_null;
         bitboard::Bitboard position_key;
     };
 
@@ -56,6 +58,8 @@ namespace board
 
         void loadFromFen(const std::string &fen);
         std::string toString() const;
+        // the full move number counts from the position the state was loaded from
+        std::string toFen() const;
 
         std::array<int, constants::SQUARES_AMOUNT_PADDED> pieces;
         std::array<bitboard::Bitboard, 3> pawns;
@@ -67,6 +71,8 @@ namespace board
 
         int ply;
         int his_ply;
+        // plies since the last null move, positions before it can't repeat
+        int plies_from_null;
 
         int castle_permissions;
 
@@ -78,13 +84,17 @@ namespace board
         std::array<int, 2> knights_bishops_count;
         std::array<int, 2> material;
 
+        // Packed midgame/endgame material and piece-square score (white minus black), and the game phase.
+        // Both are kept up to date by addPiece, clearPiece and movePiece.
+        int psq_score;
+        int phase;
+
         RandomPieceKeys piece_keys;
 
         std::array<std::vector<int>, 13> piece_list;
         std::vector<UndoInfo> undo_stack;
         std::vector<move::Move> pv_array;
 
-        std::array<std::array<int, constants::SQUARES_AMOUNT_PADDED>, 13> search_history;
         std::array<std::array<move::Move, BETA_KILLER_STORAGE>, 2> search_killers;
 
         std::array<std::array<int, 13>, 13> move_ordering_scores;
@@ -98,6 +108,11 @@ namespace board
         void updateMaterialLists();
         int checkBoard();
         bool isRepetition() const;
+        // earlier occurrences of the position, 2 makes a threefold repetition
+        int repetitionCount() const;
+        bool hasUpcomingRepetition() const;
+        // only kings and at most one minor piece are left
+        bool isInsufficientMaterial() const;
 
 
 
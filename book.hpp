@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <random>
+#include <cinttypes>
+
+#include "board.hpp"
+#include "move.hpp"
+#include "bitboard.hpp"
+#include "mappedfile.hpp"
+
+namespace book {
+
+	// Zobrist key of a position as defined by the Polyglot book format.
+	// This is independent of BoardState::position_key, which uses its own random numbers.
+	bitboard::Bitboard polyglotKey(const board::BoardState& state);
+
+	// Polyglot .bin opening book. The file is memory-mapped once when opened and entries
+	// are looked up with a binary search over the sorted keys, so a probe never touches the disk.
+	class Book {
+	public:
+		Book();
+
+		Book(const Book&) = delete;
+		Book& operator=(const Book&) = delete;
+
+		bool open(const std::string& path);
+		void close();
+		bool isOpen() const;
+
+		// Returns a legal book move for the position or a null move if the position isn't in the book.
+		// With random set, moves are picked with probability proportional to their weight,
+		// otherwise the move with the highest weight is played.
+		move::Move probe(board::BoardState& state, bool random);
+
+	private:
+		struct Entry {
+			uint64_t key;
+			uint16_t move;
+			uint16_t weight;
+		};
+
+		Entry entryAt(size_t index) const;
+		size_t lowerBound(uint64_t key) const;
+		move::Move decodeMove(board::BoardState& state, uint16_t book_move) const;
+
+		mappedfile::MappedFile file;
+		size_t entry_count;
+
+		std::mt19937_64 generator;
+	};
+
+}
\ No newline at end of file
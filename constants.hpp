@@ -3,6 +3,7 @@
 #include <cinttypes>
 #include <array>
 #include <string>
+#include <vector>
 
 #define asInt(x) static_cast<int>(x)
 
@@ -29,6 +30,7 @@ namespace constants
     inline const int RANDOM_SEED = 1234;
     constexpr int INFINITE_VAL = 999999999;
     constexpr int MATE = 99999998;
+    constexpr int TB_WIN = MATE - 1000; // tablebase wins rank below every mate the search can find
 
     enum class Color
     {
@@ -54,37 +56,44 @@ namespace constants
         bK
     };
 
-    inline const std::array<int, 13> IS_QUEEN = { 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0 };
-    inline const std::array<int, 13> IS_ROOK = { 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0 };
-    inline const std::array<int, 13> IS_BISHOP = { 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 0 };
+    constexpr std::array<int, 13> IS_QUEEN = { 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0 };
+    constexpr std::array<int, 13> IS_ROOK = { 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0 };
+    constexpr std::array<int, 13> IS_BISHOP = { 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 0 };
 
-    inline const std::array<int, 13> IS_KNIGHT = { 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0 };
-    inline const std::array<int, 13> IS_BISHOP_QUEEN = { 0, 0, 0, 1, 0, 1, 0, 0, 0, 1, 0, 1, 0 };
-    inline const std::array<int, 13> IS_ROOK_QUEEN = { 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 1, 1, 0 };
-    inline const std::array<int, 13> IS_KING = { 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1 };
+    constexpr std::array<int, 13> IS_KNIGHT = { 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0 };
+    constexpr std::array<int, 13> IS_BISHOP_QUEEN = { 0, 0, 0, 1, 0, 1, 0, 0, 0, 1, 0, 1, 0 };
+    constexpr std::array<int, 13> IS_ROOK_QUEEN = { 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 1, 1, 0 };
+    constexpr std::array<int, 13> IS_KING = { 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1 };
 
-    inline const std::array<int, 13> IS_NOT_PAWN = { 0, 0, 1, 1, 1, 1, 1, 0, 1 ,1, 1 , 1, 1 };
-    inline const std::array<int, 13> IS_ROOK_QUEEN_KING = {0, 0, 0, 0, 1, 1, 1, 0, 0, 0, 1, 1, 1 };
-    inline const std::array<int, 13> IS_KNIGHT_BISHOP ={ 0, 0, 1, 1, 0, 0, 0, 0, 1, 1, 0, 0, 0 };
-    inline const std::array<Color, 13> PIECE_COLOR = { Color::BOTH, Color::WHITE, Color::WHITE, Color::WHITE, Color::WHITE, Color::WHITE, Color::WHITE,
+    constexpr std::array<int, 13> IS_NOT_PAWN = { 0, 0, 1, 1, 1, 1, 1, 0, 1 ,1, 1 , 1, 1 };
+    constexpr std::array<int, 13> IS_ROOK_QUEEN_KING = {0, 0, 0, 0, 1, 1, 1, 0, 0, 0, 1, 1, 1 };
+    constexpr std::array<int, 13> IS_KNIGHT_BISHOP ={ 0, 0, 1, 1, 0, 0, 0, 0, 1, 1, 0, 0, 0 };
+    constexpr std::array<Color, 13> PIECE_COLOR = { Color::BOTH, Color::WHITE, Color::WHITE, Color::WHITE, Color::WHITE, Color::WHITE, Color::WHITE,
                                                        Color::BLACK, Color::BLACK, Color::BLACK, Color::BLACK, Color::BLACK, Color::BLACK};
 
-    inline const std::array<int, 13> VICTIM_SCORE = { 0, 100, 200, 300, 400, 500, 600, 100, 200, 300, 400, 500, 600 };
-
-    inline const std::array<std::vector<int>, 13> PIECE_MOVEMENT = { 
-        std::vector<int>{},
-        std::vector<int>{}, 
-        std::vector<int>{-8, -19, -21, -12, 8, 19, 21, 12},
-        std::vector<int>{-9, -11, 11, 9},
-        std::vector<int>{-1, -10, 1, 10},
-        std::vector<int>{-1, -10, 1, 10, -9, -11, 11, 9},
-        std::vector<int>{-1, -10, 1, 10, -9, -11, 11, 9},
-        std::vector<int>{},
-        std::vector<int>{-8, -19, -21, -12, 8, 19, 21, 12},
-        std::vector<int>{-9, -11, 11, 9},
-        std::vector<int>{-1, -10, 1, 10},
-        std::vector<int>{-1, -10, 1, 10, -9, -11, 11, 9},
-        std::vector<int>{-1, -10, 1, 10, -9, -11, 11, 9}                                         
+    constexpr std::array<int, 13> VICTIM_SCORE = { 0, 100, 200, 300, 400, 500, 600, 100, 200, 300, 400, 500, 600 };
+
+    // Directions on the 120 square board as a fixed size list, so the tables are built at compile time without heap allocation
+    struct DirectionList
+    {
+        std::array<int, 8> directions;
+        int count;
+
+        constexpr const int *begin() const { return directions.data(); }
+        constexpr const int *end() const { return directions.data() + count; }
+    };
+
+    constexpr DirectionList KNIGHT_DIRECTIONS = { { -8, -19, -21, -12, 8, 19, 21, 12 }, 8 };
+    constexpr DirectionList BISHOP_DIRECTIONS = { { -9, -11, 11, 9 }, 4 };
+    constexpr DirectionList ROOK_DIRECTIONS = { { -1, -10, 1, 10 }, 4 };
+    constexpr DirectionList KING_DIRECTIONS = { { -1, -10, 1, 10, -9, -11, 11, 9 }, 8 };
+    constexpr DirectionList WHITE_PAWN_CAPTURES = { { 9, 11 }, 2 };
+    constexpr DirectionList BLACK_PAWN_CAPTURES = { { -9, -11 }, 2 };
+
+    // pawns move by their own rules
+    constexpr std::array<DirectionList, 13> PIECE_MOVEMENT = {
+        DirectionList{}, DirectionList{}, KNIGHT_DIRECTIONS, BISHOP_DIRECTIONS, ROOK_DIRECTIONS, KING_DIRECTIONS, KING_DIRECTIONS,
+        DirectionList{}, KNIGHT_DIRECTIONS, BISHOP_DIRECTIONS, ROOK_DIRECTIONS, KING_DIRECTIONS, KING_DIRECTIONS
     };
 
     constexpr int DIR_UP = 10;
@@ -196,71 +205,83 @@ namespace constants
         OFFBOARD
     };
 
-    const std::array<int, 120> CASTLE_PERMISSIONS =
-    {
-     15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
-     15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
-     15, 13, 15, 15, 15, 12, 15, 15, 14, 15,
-     15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
-     15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
-     15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
-     15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
-     15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
-     15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
-     15,  7, 15, 15, 15,  3, 15, 15, 11, 15,
-     15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
-     15, 15, 15, 15, 15, 15, 15, 15, 15, 15
-    };
+    // Chebyshev distance between two squares of the 64 square board, the number of king moves from one to the other
+    constexpr std::array<std::array<int, 64>, 64> generateSquareDistance() {
+        std::array<std::array<int, 64>, 64> result = {};
+
+        for (int from = 0; from < 64; from++) {
+            for (int to = 0; to < 64; to++) {
+                int row_distance = from / 8 > to / 8 ? from / 8 - to / 8 : to / 8 - from / 8;
+                int col_distance = from % 8 > to % 8 ? from % 8 - to % 8 : to % 8 - from % 8;
+                result[from][to] = row_distance > col_distance ? row_distance : col_distance;
+            }
+        }
+
+        return result;
+    }
+
+    constexpr std::array<std::array<int, 64>, 64> SQUARE_DISTANCE = generateSquareDistance();
+
+    // Step on the 120 square board that leads from one square of the 64 square board to the other along a rank,
+    // file or diagonal, 0 if they don't share a line
+    constexpr std::array<std::array<int, 64>, 64> generateLineDirection() {
+        std::array<std::array<int, 64>, 64> result = {};
+
+        for (int from = 0; from < 64; from++) {
+            for (int to = 0; to < 64; to++) {
+                int row_distance = to / 8 - from / 8;
+                int col_distance = to % 8 - from % 8;
+                bool aligned = row_distance == 0 || col_distance == 0 || row_distance == col_distance || row_distance == -col_distance;
+
+                if (from != to && aligned)
+                    result[from][to] = ((row_distance > 0) - (row_distance < 0)) * 10 + (col_distance > 0) - (col_distance < 0);
+            }
+        }
+
+        return result;
+    }
+
+    constexpr std::array<std::array<int, 64>, 64> LINE_DIRECTION = generateLineDirection();
 
     // evaluation
 
-    inline const std::array<int, 13> PIECE_VALUE = { 0, 100, 325, 325, 550, 1000, 50000, 100, 325, 325, 550, 1000, 50000 };
-
-    const std::array<int, 64> PAWN_VALUE_TABLE = {
-    0	,	0	,	0	,	0	,	0	,	0	,	0	,	0	,
-    10	,	10	,	0	,	-10	,	-10	,	0	,	10	,	10	,
-    5	,	0	,	0	,	5	,	5	,	0	,	0	,	5	,
-    0	,	0	,	10	,	20	,	20	,	10	,	0	,	0	,
-    5	,	5	,	5	,	10	,	10	,	5	,	5	,	5	,
-    10	,	10	,	10	,	20	,	20	,	10	,	10	,	10	,
-    20	,	20	,	20	,	30	,	30	,	20	,	20	,	20	,
-    0	,	0	,	0	,	0	,	0	,	0	,	0	,	0
-    };
+    // Scores carry a midgame and an endgame value packed into one int, the endgame half in the upper 16 bits.
+    // Packed scores can be added, subtracted and multiplied by an int like plain integers,
+    // so every evaluation term accumulates both halves with a single operation.
+    constexpr int makeScore(int mg, int eg) {
+        return static_cast<int>(static_cast<unsigned int>(eg) << 16) + mg;
+    }
 
-    const std::array<int, 64> KNIGHT_VALUE_TABLE = {
-    0	,	-10	,	0	,	0	,	0	,	0	,	-10	,	0	,
-    0	,	0	,	0	,	5	,	5	,	0	,	0	,	0	,
-    0	,	0	,	10	,	10	,	10	,	10	,	0	,	0	,
-    0	,	0	,	10	,	20	,	20	,	10	,	5	,	0	,
-    5	,	10	,	15	,	20	,	20	,	15	,	10	,	5	,
-    5	,	10	,	10	,	20	,	20	,	10	,	10	,	5	,
-    0	,	0	,	5	,	10	,	10	,	5	,	0	,	0	,
-    0	,	0	,	0	,	0	,	0	,	0	,	0	,	0
-    };
+    constexpr int mgScore(int score) {
+        return static_cast<int16_t>(static_cast<uint16_t>(static_cast<unsigned int>(score)));
+    }
 
-    const std::array<int, 64> BISHOP_VALUE_TABLE = {
-    0	,	0	,	-10	,	0	,	0	,	-10	,	0	,	0	,
-    0	,	0	,	0	,	10	,	10	,	0	,	0	,	0	,
-    0	,	0	,	10	,	15	,	15	,	10	,	0	,	0	,
-    0	,	10	,	15	,	20	,	20	,	15	,	10	,	0	,
-    0	,	10	,	15	,	20	,	20	,	15	,	10	,	0	,
-    0	,	0	,	10	,	15	,	15	,	10	,	0	,	0	,
-    0	,	0	,	0	,	10	,	10	,	0	,	0	,	0	,
-    0	,	0	,	0	,	0	,	0	,	0	,	0	,	0
-    };
+    constexpr int egScore(int score) {
+        return static_cast<int16_t>(static_cast<uint16_t>(static_cast<unsigned int>(score + 0x8000) >> 16));
+    }
 
-    const std::array<int, 64> ROOK_VALUE_TABLE = {
-    0	,	0	,	5	,	10	,	10	,	5	,	0	,	0	,
-    0	,	0	,	5	,	10	,	10	,	5	,	0	,	0	,
-    0	,	0	,	5	,	10	,	10	,	5	,	0	,	0	,
-    0	,	0	,	5	,	10	,	10	,	5	,	0	,	0	,
-    0	,	0	,	5	,	10	,	10	,	5	,	0	,	0	,
-    0	,	0	,	5	,	10	,	10	,	5	,	0	,	0	,
-    25	,	25	,	25	,	25	,	25	,	25	,	25	,	25	,
-    0	,	0	,	5	,	10	,	10	,	5	,	0	,	0
-    };
+}
+
+// material, mobility, king safety and piece-square tables, rewritten by the tuner
+#include "evalparams.hpp"
 
-    const std::array<int, 64> MIRROR_SQUARE = {
+namespace constants
+{
+
+    // Kings can never be captured, so they don't count towards material
+    constexpr std::array<int, 13> PIECE_VALUE = { 0, 100, 325, 325, 550, 1000, 0, 100, 325, 325, 550, 1000, 0 };
+
+    // MVV-LVA keeps a king worth more than everything else, so captures by the king are ordered last
+    constexpr std::array<int, 13> CAPTURE_ORDER_VALUE = { 0, 100, 325, 325, 550, 1000, 50000, 100, 325, 325, 550, 1000, 50000 };
+
+    // The phase is TOTAL_PHASE with all pieces on the board and drops to 0 once only kings and pawns are left
+    constexpr std::array<int, 13> PHASE_WEIGHT = { 0, 0, 1, 1, 2, 4, 0, 0, 1, 1, 2, 4, 0 };
+    constexpr int TOTAL_PHASE = 24;
+
+    // Reachable square count of an average placement, mobility is scored relative to it
+    constexpr std::array<int, 13> MOBILITY_CENTER = { 0, 0, 4, 7, 7, 14, 0, 0, 4, 7, 7, 14, 0 };
+
+    constexpr std::array<int, 64> MIRROR_SQUARE = {
     56	,	57	,	58	,	59	,	60	,	61	,	62	,	63	,
     48	,	49	,	50	,	51	,	52	,	53	,	54	,	55	,
     40	,	41	,	42	,	43	,	44	,	45	,	46	,	47	,
@@ -271,6 +292,50 @@ namespace constants
     0	,	1	,	2	,	3	,	4	,	5	,	6	,	7
     };
 
+    constexpr const std::array<int, 64>& pieceSquareTableMg(int piece) {
+        switch (piece) {
+        case asInt(Piece::wP): case asInt(Piece::bP): return PAWN_MG_TABLE;
+        case asInt(Piece::wN): case asInt(Piece::bN): return KNIGHT_MG_TABLE;
+        case asInt(Piece::wB): case asInt(Piece::bB): return BISHOP_MG_TABLE;
+        case asInt(Piece::wR): case asInt(Piece::bR): return ROOK_MG_TABLE;
+        case asInt(Piece::wQ): case asInt(Piece::bQ): return QUEEN_MG_TABLE;
+        default: return KING_MG_TABLE;
+        }
+    }
+
+    constexpr const std::array<int, 64>& pieceSquareTableEg(int piece) {
+        switch (piece) {
+        case asInt(Piece::wP): case asInt(Piece::bP): return PAWN_EG_TABLE;
+        case asInt(Piece::wN): case asInt(Piece::bN): return KNIGHT_EG_TABLE;
+        case asInt(Piece::wB): case asInt(Piece::bB): return BISHOP_EG_TABLE;
+        case asInt(Piece::wR): case asInt(Piece::bR): return ROOK_EG_TABLE;
+        case asInt(Piece::wQ): case asInt(Piece::bQ): return QUEEN_EG_TABLE;
+        default: return KING_EG_TABLE;
+        }
+    }
+
+    // Packed material plus piece-square score of every piece on every 120 square, negated for black pieces.
+    // The board keeps the sum of these up to date incrementally.
+    constexpr std::array<std::array<int, SQUARES_AMOUNT_PADDED>, PIECE_TYPE_COUNT> generatePieceSquareScores() {
+        std::array<std::array<int, SQUARES_AMOUNT_PADDED>, PIECE_TYPE_COUNT> result = {};
+
+        for (int piece = asInt(Piece::wP); piece <= asInt(Piece::bK); piece++) {
+            bool is_white = piece <= asInt(Piece::wK);
+
+            for (int square = 0; square < SQUARES_AMOUNT; square++) {
+                int table_square = is_white ? square : MIRROR_SQUARE[square];
+                int score = makeScore(PIECE_VALUE_MG[piece] + pieceSquareTableMg(piece)[table_square],
+                                      PIECE_VALUE_EG[piece] + pieceSquareTableEg(piece)[table_square]);
+
+                result[piece][square + 21 + 2 * (square / 8)] = is_white ? score : -score;
+            }
+        }
+
+        return result;
+    }
+
+    constexpr std::array<std::array<int, SQUARES_AMOUNT_PADDED>, PIECE_TYPE_COUNT> PIECE_SQUARE_SCORE = generatePieceSquareScores();
+
 
 
     enum class Castle
@@ -281,5 +346,24 @@ namespace constants
         bQ = 8
     };
 
+    // Castle permissions that stay after a move from or to a square: moving a king or rook, or capturing a rook, gives them up
+    constexpr std::array<int, SQUARES_AMOUNT_PADDED> generateCastlePermissions() {
+        std::array<int, SQUARES_AMOUNT_PADDED> result = {};
+
+        for (int &permissions : result)
+            permissions = 15;
+
+        result[asInt(Square::A1)] &= ~asInt(Castle::wQ);
+        result[asInt(Square::E1)] &= ~(asInt(Castle::wK) | asInt(Castle::wQ));
+        result[asInt(Square::H1)] &= ~asInt(Castle::wK);
+        result[asInt(Square::A8)] &= ~asInt(Castle::bQ);
+        result[asInt(Square::E8)] &= ~(asInt(Castle::bK) | asInt(Castle::bQ));
+        result[asInt(Square::H8)] &= ~asInt(Castle::bK);
+
+        return result;
+    }
+
+    constexpr std::array<int, SQUARES_AMOUNT_PADDED> CASTLE_PERMISSIONS = generateCastlePermissions();
+
 
 } // namespace constants
\ No newline at end of file
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <cinttypes>
+
+#include "bitboard.hpp"
+#include "stats.hpp"
+
+namespace evaltable {
+
+	// Cache for static evaluations, sized independently of the PVTable.
+	// Every slot is a single 64 bit word holding the upper half of the position key and the score,
+	// so reads and writes are lock-free and a slot written concurrently by another search thread
+	// can at worst show up as a miss, never as a wrong score.
+	class EvalTable {
+	public:
+		EvalTable(size_t size) : size(size), hits(0), misses(0) {
+			data = std::make_unique<std::atomic<uint64_t>[]>(size);
+			clear();
+		}
+
+		EvalTable() : EvalTable(100000) {}
+
+		void clear() {
+			for (size_t i = 0; i < size; i++) {
+				data[i].store(0, std::memory_order_relaxed);
+			}
+
+			resetCounters();
+		}
+
+		void resetCounters() {
+			hits.store(0, std::memory_order_relaxed);
+			misses.store(0, std::memory_order_relaxed);
+		}
+
+		void add(bitboard::Bitboard key, int score) {
+			size_t index = key % size;
+			assert(index < size);
+			data[index].store((key & KEY_MASK) | static_cast<uint32_t>(score), std::memory_order_relaxed);
+		}
+
+		bool probe(bitboard::Bitboard key, int& score) {
+			size_t index = key % size;
+			assert(index < size);
+
+			uint64_t entry = data[index].load(std::memory_order_relaxed);
+
+			if ((entry & KEY_MASK) == (key & KEY_MASK) && entry != 0) {
+				score = static_cast<int32_t>(static_cast<uint32_t>(entry));
+
+				if constexpr (stats::ENABLED)
+					hits.fetch_add(1, std::memory_order_relaxed);
+
+				return true;
+			}
+
+			if constexpr (stats::ENABLED)
+				misses.fetch_add(1, std::memory_order_relaxed);
+
+			return false;
+		}
+
+		// only counted in builds with SEARCH_STATS, like the search statistics
+		uint64_t getHits() const { return hits.load(std::memory_order_relaxed); }
+		uint64_t getMisses() const { return misses.load(std::memory_order_relaxed); }
+
+	private:
+		static constexpr uint64_t KEY_MASK = 0xFFFFFFFF00000000ULL;
+
+		size_t size;
+		std::unique_ptr<std::atomic<uint64_t>[]> data;
+
+		std::atomic<uint64_t> hits;
+		std::atomic<uint64_t> misses;
+	};
+
+}
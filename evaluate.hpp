@@ -1,53 +1,103 @@
 #pragma once
 
 #include <iostream>
+#include <algorithm>
+#include <cstdlib>
+
 #include "board.hpp"
 #include "constants.hpp"
 #include "util.hpp"
 
 namespace evaluate {
-	inline int evaluatePosition(const board::BoardState& state) {
-		int score = state.material[asInt(constants::Color::WHITE)] - state.material[asInt(constants::Color::BLACK)];
-		// pawns
 
-		for (int piece_square : state.piece_list[asInt(constants::Piece::wP)]){
-			score += constants::PAWN_VALUE_TABLE[util::_120To64(piece_square)];
-		}
+	constexpr std::array<constants::Piece, 4> WHITE_MOBILE_PIECES = { constants::Piece::wN, constants::Piece::wB, constants::Piece::wR, constants::Piece::wQ };
+	constexpr std::array<constants::Piece, 4> BLACK_MOBILE_PIECES = { constants::Piece::bN, constants::Piece::bB, constants::Piece::bR, constants::Piece::bQ };
 
-		for (int piece_square : state.piece_list[asInt(constants::Piece::bP)]) {
-			score -= constants::PAWN_VALUE_TABLE[constants::MIRROR_SQUARE[util::_120To64(piece_square)]];
-		}
+	inline bool isNextToSquare(int square, int other) {
+		return constants::SQUARE_DISTANCE[util::_120To64(square)][util::_120To64(other)] <= 1;
+	}
 
-		// knights
+	// Counts the squares a knight, bishop, rook or queen can move to and the squares it sees next to the enemy king
+	inline void pieceActivity(const board::BoardState& state, constants::Piece piece, int piece_square, int enemy_king, int& mobility, int& king_attacks) {
+		constants::Color color = constants::PIECE_COLOR[asInt(piece)];
+		bool is_sliding = !constants::IS_KNIGHT[asInt(piece)];
 
-		for (int piece_square : state.piece_list[asInt(constants::Piece::wN)]) {
-			score += constants::KNIGHT_VALUE_TABLE[util::_120To64(piece_square)];
-		}
+		mobility = 0;
+		king_attacks = 0;
 
-		for (int piece_square : state.piece_list[asInt(constants::Piece::bN)]) {
-			score -= constants::KNIGHT_VALUE_TABLE[constants::MIRROR_SQUARE[util::_120To64(piece_square)]];
-		}
+		for (int direction : constants::PIECE_MOVEMENT[asInt(piece)]) {
+			int _square = piece_square + direction;
 
-		// bishops
+			while (state.pieces[_square] != asInt(constants::Square::OFFBOARD)) {
+				if (isNextToSquare(_square, enemy_king))
+					king_attacks++;
 
-		for (int piece_square : state.piece_list[asInt(constants::Piece::wB)]) {
-			score += constants::BISHOP_VALUE_TABLE[util::_120To64(piece_square)];
-		}
+				if (state.pieces[_square] != asInt(constants::Piece::EMPTY)) {
+					if (constants::PIECE_COLOR[state.pieces[_square]] != color)
+						mobility++;
+					break;
+				}
+
+				mobility++;
 
-		for (int piece_square : state.piece_list[asInt(constants::Piece::bB)]) {
-			score -= constants::BISHOP_VALUE_TABLE[constants::MIRROR_SQUARE[util::_120To64(piece_square)]];
+				if (!is_sliding)
+					break;
+
+				_square += direction;
+			}
 		}
+	}
+
+	// Mobility and attacks on the squares around the enemy king for all minor and major pieces of one side.
+	// Returns a packed score from the point of view of that side.
+	inline int evaluatePieces(const board::BoardState& state, constants::Color color) {
+		const auto& mobile_pieces = color == constants::Color::WHITE ? WHITE_MOBILE_PIECES : BLACK_MOBILE_PIECES;
+		int enemy_king = state.piece_list[color == constants::Color::WHITE ? asInt(constants::Piece::bK) : asInt(constants::Piece::wK)][0];
+		int score = 0;
 
-		// rooks
+		for (constants::Piece piece : mobile_pieces) {
+			for (int piece_square : state.piece_list[asInt(piece)]) {
+				int mobility;
+				int king_attacks;
 
-		for (int piece_square : state.piece_list[asInt(constants::Piece::wR)]) {
-			score += constants::ROOK_VALUE_TABLE[util::_120To64(piece_square)];
+				pieceActivity(state, piece, piece_square, enemy_king, mobility, king_attacks);
+
+				score += constants::MOBILITY_SCORE[asInt(piece)] * (mobility - constants::MOBILITY_CENTER[asInt(piece)]);
+				score += constants::KING_ATTACK_SCORE[asInt(piece)] * king_attacks;
+			}
 		}
 
-		for (int piece_square : state.piece_list[asInt(constants::Piece::bR)]) {
-			score -= constants::ROOK_VALUE_TABLE[constants::MIRROR_SQUARE[util::_120To64(piece_square)]];
+		return score;
+	}
+
+	// Own pawns directly in front of the king, one or two ranks ahead on the king file and its neighbours
+	inline int evaluatePawnShield(const board::BoardState& state, constants::Color color) {
+		int king = state.piece_list[color == constants::Color::WHITE ? asInt(constants::Piece::wK) : asInt(constants::Piece::bK)][0];
+		int pawn = color == constants::Color::WHITE ? asInt(constants::Piece::wP) : asInt(constants::Piece::bP);
+		int forward = color == constants::Color::WHITE ? constants::DIR_UP : constants::DIR_DOWN;
+		int score = 0;
+
+		for (int side : { constants::DIR_LEFT, 0, constants::DIR_RIGHT }) {
+			if (state.pieces[king + forward + side] == pawn)
+				score += constants::PAWN_SHIELD_SCORE[0];
+			else if (state.pieces[king + 2 * forward + side] == pawn)
+				score += constants::PAWN_SHIELD_SCORE[1];
 		}
-		
-		return state.player == constants::Color::WHITE ? score : -score;
+
+		return score;
+	}
+
+	inline int evaluatePosition(const board::BoardState& state) {
+		// material and piece-square tables are kept up to date by the board
+		int score = state.psq_score;
+
+		score += evaluatePieces(state, constants::Color::WHITE) - evaluatePieces(state, constants::Color::BLACK);
+		score += evaluatePawnShield(state, constants::Color::WHITE) - evaluatePawnShield(state, constants::Color::BLACK);
+
+		// promotions can push the phase past its starting value
+		int phase = std::min(state.phase, constants::TOTAL_PHASE);
+		int tapered = (constants::mgScore(score) * phase + constants::egScore(score) * (constants::TOTAL_PHASE - phase)) / constants::TOTAL_PHASE;
+
+		return state.player == constants::Color::WHITE ? tapered : -tapered;
 	}
 }
\ No newline at end of file
@@ -0,0 +1,276 @@
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include "gensfen.hpp"
+#include "search.hpp"
+#include "movegen.hpp"
+#include "attack.hpp"
+#include "util.hpp"
+#include "threadbinding.hpp"
+
+namespace gensfen {
+
+	constexpr size_t TABLE_SIZE = 1 << 20;
+	constexpr size_t EVAL_TABLE_SIZE = 1 << 18;
+	// positions collected by a thread before they are written out
+	constexpr size_t BUFFERED_POSITIONS = 1 << 15;
+	constexpr int PROGRESS_INTERVAL = 10000;
+
+	static void writeLittleEndian(PackedPosition& packed, size_t offset, uint64_t value, size_t bytes) {
+		for (size_t i = 0; i < bytes; i++)
+			packed[offset + i] = static_cast<uint8_t>(value >> (8 * i));
+	}
+
+	static uint64_t readLittleEndian(const PackedPosition& packed, size_t offset, size_t bytes) {
+		uint64_t value = 0;
+
+		for (size_t i = 0; i < bytes; i++)
+			value |= static_cast<uint64_t>(packed[offset + i]) << (8 * i);
+
+		return value;
+	}
+
+	PackedPosition pack(const board::BoardState& state, int score, int result) {
+		PackedPosition packed = {};
+		uint64_t occupancy = 0;
+		int nibble = 0;
+
+		for (int square = 0; square < constants::SQUARES_AMOUNT; square++) {
+			int piece = state.pieces[util::_64To120(square)];
+
+			if (piece == asInt(constants::Piece::EMPTY))
+				continue;
+
+			assert(nibble < 32);
+			occupancy |= 1ULL << square;
+			packed[8 + nibble / 2] |= piece << (nibble % 2 * 4);
+			nibble++;
+		}
+
+		writeLittleEndian(packed, 0, occupancy, 8);
+		packed[24] = (state.player == constants::Color::BLACK) | state.castle_permissions << 1;
+		packed[25] = state.en_passant == asInt(constants::Square::OFFBOARD) ? 64 : util::_120To64(state.en_passant);
+		packed[26] = static_cast<uint8_t>(std::min(state.fifty_move, 255));
+		packed[27] = static_cast<uint8_t>(static_cast<int8_t>(result));
+		writeLittleEndian(packed, 28, static_cast<uint16_t>(static_cast<int16_t>(std::clamp(score, -32000, 32000))), 2);
+		writeLittleEndian(packed, 30, static_cast<uint16_t>(std::min(state.his_ply, 0xFFFF)), 2);
+
+		return packed;
+	}
+
+	std::string unpack(const PackedPosition& packed, int& score, int& result) {
+		const char* PIECE_CHARS = ".PNBRQKpnbrqk";
+
+		uint64_t occupancy = readLittleEndian(packed, 0, 8);
+		std::array<int, constants::SQUARES_AMOUNT> board = {};
+		int nibble = 0;
+
+		for (int square = 0; square < constants::SQUARES_AMOUNT; square++) {
+			if (occupancy >> square & 1) {
+				board[square] = packed[8 + nibble / 2] >> (nibble % 2 * 4) & 0xF;
+				nibble++;
+			}
+		}
+
+		std::string fen;
+
+		for (int rank = 7; rank >= 0; rank--) {
+			int empty = 0;
+
+			for (int file = 0; file < 8; file++) {
+				int piece = board[rank * 8 + file];
+
+				if (!piece) {
+					empty++;
+					continue;
+				}
+
+				if (empty)
+					fen += std::to_string(empty);
+
+				empty = 0;
+				fen += PIECE_CHARS[piece];
+			}
+
+			if (empty)
+				fen += std::to_string(empty);
+
+			if (rank)
+				fen += '/';
+		}
+
+		int castle = packed[24] >> 1 & 0xF;
+		std::string castling;
+
+		if (castle & asInt(constants::Castle::wK)) castling += 'K';
+		if (castle & asInt(constants::Castle::wQ)) castling += 'Q';
+		if (castle & asInt(constants::Castle::bK)) castling += 'k';
+		if (castle & asInt(constants::Castle::bQ)) castling += 'q';
+
+		int ply = static_cast<int>(readLittleEndian(packed, 30, 2));
+
+		fen += packed[24] & 1 ? " b " : " w ";
+		fen += castling.empty() ? "-" : castling;
+		fen += " ";
+		fen += packed[25] == 64 ? "-" : util::_120ToString(util::_64To120(packed[25]));
+		fen += " " + std::to_string(packed[26]) + " " + std::to_string(ply / 2 + 1);
+
+		result = static_cast<int8_t>(packed[27]);
+		score = static_cast<int16_t>(readLittleEndian(packed, 28, 2));
+
+		return fen;
+	}
+
+	// Plays random legal moves, returns false if the game ended on the way
+	static bool playRandomMoves(board::BoardState& state, int count, std::mt19937_64& generator) {
+		for (int i = 0; i < count; i++) {
+			std::vector<move::Move> legal_moves;
+
+			for (const auto& move : movegen::generateAllMoves(state)) {
+				if (!state.step(move))
+					continue;
+
+				state.undo();
+				legal_moves.push_back(move);
+			}
+
+			if (legal_moves.empty())
+				return false;
+
+			state.step(legal_moves[std::uniform_int_distribution<size_t>(0, legal_moves.size() - 1)(generator)]);
+		}
+
+		return true;
+	}
+
+	struct Shared {
+		std::ofstream file;
+		std::mutex file_mutex;
+		std::atomic<long> games_started = 0;
+		std::atomic<long> games_finished = 0;
+		std::atomic<long> positions = 0;
+		std::atomic<int> threads_running = 0;
+	};
+
+	static void flush(Shared& shared, std::vector<PackedPosition>& buffer) {
+		std::lock_guard<std::mutex> lock(shared.file_mutex);
+		shared.file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * PACKED_SIZE);
+		buffer.clear();
+	}
+
+	static void playGames(const Options& options, Shared& shared, int thread_index) {
+		threadbinding::bindThisThread(thread_index);
+
+		board::BoardState state;
+		search::Searcher searcher(TABLE_SIZE, EVAL_TABLE_SIZE, options.depth ? options.depth : search::MAX_DEPTH);
+		searcher.print_info = false;
+		searcher.timeset = false;
+		searcher.node_limit = options.nodes;
+
+		std::random_device seed;
+		std::mt19937_64 generator(seed() + thread_index);
+		std::vector<PackedPosition> game;
+		std::vector<PackedPosition> buffer;
+		buffer.reserve(BUFFERED_POSITIONS);
+
+		while (shared.games_started++ < options.games) {
+			state.loadFromFen(constants::FEN_START_POS);
+			searcher.history.clear();
+			game.clear();
+
+			int white_result = 0;
+
+			if (playRandomMoves(state, options.random_moves, generator)) {
+				while (true) {
+					if (state.fifty_move >= 100 || state.isRepetition() || state.isInsufficientMaterial() || state.his_ply >= options.max_plies)
+						break;
+
+					searcher.stopped = false;
+					searcher.start_time = util::getTimeInMs();
+					searcher.think(state);
+
+					if (searcher.root_moves.empty()) {
+						if (attack::isInCheck(state))
+							white_result = state.player == constants::Color::WHITE ? -1 : 1;
+						break;
+					}
+
+					// a node limit can stop the search before the best move of the last iteration got its new score
+					const search::RootMove& best = searcher.root_moves[0];
+					int score = best.lastScore();
+
+					if (score != -constants::INFINITE_VAL) {
+						game.push_back(pack(state, score, 0));
+
+						// mates and tablebase wins found by the search decide the game
+						if (std::abs(score) >= constants::TB_WIN - search::MAX_DEPTH) {
+							white_result = (score > 0) == (state.player == constants::Color::WHITE) ? 1 : -1;
+							break;
+						}
+					}
+
+					state.step(best.move);
+				}
+			}
+
+			for (auto& packed : game) {
+				bool black = packed[24] & 1;
+				packed[27] = static_cast<uint8_t>(static_cast<int8_t>(black ? -white_result : white_result));
+				buffer.push_back(packed);
+			}
+
+			shared.positions += static_cast<long>(game.size());
+			shared.games_finished++;
+
+			if (buffer.size() >= BUFFERED_POSITIONS)
+				flush(shared, buffer);
+		}
+
+		flush(shared, buffer);
+		shared.threads_running--;
+	}
+
+	bool generate(const Options& options) {
+		Shared shared;
+		shared.file.open(options.output, std::ios::binary | std::ios::app);
+
+		if (!shared.file)
+			return false;
+
+		long start_time = util::getTimeInMs();
+		long last_report = start_time;
+		std::vector<std::thread> threads;
+
+		shared.threads_running = options.threads;
+
+		for (int i = 0; i < options.threads; i++)
+			threads.emplace_back(playGames, std::cref(options), std::ref(shared), i);
+
+		while (shared.threads_running > 0) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+			if (util::getTimeInMs() - last_report >= PROGRESS_INTERVAL) {
+				last_report = util::getTimeInMs();
+				long seconds = std::max(1L, (last_report - start_time) / 1000);
+
+				std::cout << "info string gensfen games " << shared.games_finished << "/" << options.games << " positions " << shared.positions
+					<< " (" << shared.positions / seconds << " per second)" << std::endl;
+			}
+		}
+
+		for (auto& thread : threads)
+			thread.join();
+
+		std::cout << "info string gensfen done, " << shared.games_finished << " games and " << shared.positions << " positions written to "
+			<< options.output << " in " << (util::getTimeInMs() - start_time) / 1000 << " s" << std::endl;
+
+		return static_cast<bool>(shared.file);
+	}
+
+}
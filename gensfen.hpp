@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <array>
+#include <cinttypes>
+
+#include "board.hpp"
+
+namespace gensfen {
+
+	// One training position in 32 bytes, all fields little endian:
+	//  0..7   occupancy, bit 0 is a1 and bit 63 h8
+	//  8..23  pieces of the occupied squares in square order, 4 bits each starting with the low nibble (1 wP .. 12 bK)
+	//  24     bit 0 side to move (1 is black), bits 1..4 castle permissions
+	//  25     en passant square (0..63) or 64 for none
+	//  26     fifty move counter
+	//  27     game result for the side to move: 1 win, 0 draw, -1 loss
+	//  28..29 search score for the side to move in centipawns, mate scores are clamped
+	//  30..31 ply of the game
+	constexpr size_t PACKED_SIZE = 32;
+	typedef std::array<uint8_t, PACKED_SIZE> PackedPosition;
+
+	PackedPosition pack(const board::BoardState& state, int score, int result);
+	// FEN of a packed position, the score and result are returned separately
+	std::string unpack(const PackedPosition& packed, int& score, int& result);
+
+	struct Options {
+		long games = 1000;
+		int depth = 6;
+		long nodes = 0;
+		int threads = 1;
+		// random plies played from the start position before the recorded part of a game
+		int random_moves = 8;
+		// games still running after this many plies are drawn
+		int max_plies = 400;
+		std::string output = "gensfen.bin";
+	};
+
+	// Plays the games on options.threads threads, each with its own board and searcher,
+	// and appends every searched position to the output file. Returns false if the file can't be opened.
+	bool generate(const Options& options);
+
+}
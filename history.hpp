@@ -0,0 +1,169 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <cinttypes>
+#include <algorithm>
+
+#include "board.hpp"
+#include "move.hpp"
+#include "util.hpp"
+
+namespace history {
+
+	constexpr int HISTORY_MAX = 16384;
+
+	// Gravity update: the closer an entry gets to HISTORY_MAX, the less a bonus moves it,
+	// so entries stay bounded and a run of failures pulls a high entry back quickly
+	inline void updateEntry(int16_t& entry, int bonus) {
+		bonus = std::clamp(bonus, -HISTORY_MAX, HISTORY_MAX);
+		entry += bonus - entry * std::abs(bonus) / HISTORY_MAX;
+	}
+
+	inline int depthBonus(int depth) {
+		return std::min(16 * depth * depth + 32 * depth, 1600);
+	}
+
+	// [piece][to]
+	typedef std::array<std::array<int16_t, 64>, 13> PieceToHistory;
+	// [previous piece][previous to][piece][to]
+	typedef std::array<std::array<PieceToHistory, 64>, 13> ContinuationHistory;
+
+	// Move ordering statistics for quiet moves. Unlike the killers they are kept between searches
+	// and only aged, so what was learned on the previous move isn't thrown away.
+	class History {
+	public:
+		History() : butterfly(std::make_unique<ButterflyHistory>()), counter_moves(std::make_unique<CounterMoves>()), generation(0) {
+			for (auto& table : continuation)
+				table = std::make_unique<ContinuationHistory>();
+
+			clear();
+		}
+
+		void clear() {
+			std::memset(butterfly.get(), 0, sizeof(ButterflyHistory));
+			std::memset(continuation[0].get(), 0, sizeof(ContinuationHistory));
+			std::memset(continuation[1].get(), 0, sizeof(ContinuationHistory));
+
+			for (auto& piece : *counter_moves)
+				piece.fill({});
+
+			for (auto& ages : continuation_ages)
+				for (auto& piece : ages)
+					piece.fill(generation);
+		}
+
+		// Called before every search, halves all statistics. The continuation tables are too big to walk on every move,
+		// so each of their [piece][to] rows is halved when it is used again, once for every search it missed.
+		void age() {
+			for (auto& color : *butterfly)
+				for (auto& from : color)
+					for (auto& entry : from)
+						entry /= 2;
+
+			generation++;
+		}
+
+		int quietScore(const board::BoardState& state, const move::Move& move) {
+			int piece = state.pieces[move.from];
+			int to = util::_120To64(move.to);
+			int score = (*butterfly)[asInt(state.player)][util::_120To64(move.from)][to];
+
+			for (int plies = 1; plies <= 2; plies++) {
+				PieceToHistory* entry = continuationEntry(state, plies);
+
+				if (entry)
+					score += (*entry)[piece][to];
+			}
+
+			return score;
+		}
+
+		move::Move counterMove(const board::BoardState& state) const {
+			if (state.undo_stack.empty())
+				return {};
+
+			const board::UndoInfo& previous = state.undo_stack.back();
+
+			if (previous.move.isNull())
+				return {};
+
+			return (*counter_moves)[previous.moved_piece][util::_120To64(previous.move.to)];
+		}
+
+		// best_move caused the cutoff, the quiet moves searched before it get a malus
+		void updateQuiets(const board::BoardState& state, const move::Move& best_move, const std::vector<move::Move>& quiets, int depth) {
+			int bonus = depthBonus(depth);
+
+			update(state, best_move, bonus);
+
+			for (const auto& quiet : quiets) {
+				if (!(quiet == best_move))
+					update(state, quiet, -bonus);
+			}
+
+			if (!state.undo_stack.empty() && !state.undo_stack.back().move.isNull()) {
+				const board::UndoInfo& previous = state.undo_stack.back();
+				(*counter_moves)[previous.moved_piece][util::_120To64(previous.move.to)] = best_move;
+			}
+		}
+
+	private:
+		typedef std::array<std::array<std::array<int16_t, 64>, 64>, 2> ButterflyHistory;
+		typedef std::array<std::array<move::Move, 64>, 13> CounterMoves;
+
+		// entry for the move made the given number of plies ago, null moves and the game start have none
+		PieceToHistory* continuationEntry(const board::BoardState& state, int plies) {
+			if (static_cast<int>(state.undo_stack.size()) < plies)
+				return nullptr;
+
+			const board::UndoInfo& previous = state.undo_stack[state.undo_stack.size() - plies];
+
+			if (previous.move.isNull())
+				return nullptr;
+
+			int to = util::_120To64(previous.move.to);
+			PieceToHistory& entry = (*continuation[plies - 1])[previous.moved_piece][to];
+			uint32_t& age = continuation_ages[plies - 1][previous.moved_piece][to];
+
+			if (age != generation) {
+				// after 15 halvings every entry is 0
+				int divisor = 1 << std::min<uint32_t>(generation - age, 15);
+
+				for (auto& piece : entry)
+					for (auto& value : piece)
+						value /= divisor;
+
+				age = generation;
+			}
+
+			return &entry;
+		}
+
+		void update(const board::BoardState& state, const move::Move& move, int bonus) {
+			int piece = state.pieces[move.from];
+			int to = util::_120To64(move.to);
+
+			updateEntry((*butterfly)[asInt(state.player)][util::_120To64(move.from)][to], bonus);
+
+			for (int plies = 1; plies <= 2; plies++) {
+				PieceToHistory* entry = continuationEntry(state, plies);
+
+				if (entry)
+					updateEntry((*entry)[piece][to], bonus);
+			}
+		}
+
+		std::unique_ptr<ButterflyHistory> butterfly;
+		std::unique_ptr<CounterMoves> counter_moves;
+		// one and two plies back
+		std::array<std::unique_ptr<ContinuationHistory>, 2> continuation;
+		// the search each continuation row was last aged for
+		std::array<std::array<std::array<uint32_t, 64>, 13>, 2> continuation_ages;
+		uint32_t generation;
+	};
+
+}
@@ -0,0 +1,104 @@
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mappedfile.hpp"
+
+namespace mappedfile {
+
+	MappedFile::MappedFile() : data(nullptr), size(0)
+#ifdef WIN32
+		, file_handle(nullptr), mapping_handle(nullptr)
+#endif
+	{}
+
+	MappedFile::~MappedFile() {
+		close();
+	}
+
+	bool MappedFile::open(const std::string& path) {
+		close();
+
+#ifdef WIN32
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER file_size;
+
+		if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+			CloseHandle(file);
+			return false;
+		}
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+		if (!mapping) {
+			CloseHandle(file);
+			return false;
+		}
+
+		void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+		if (!view) {
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+
+		file_handle = file;
+		mapping_handle = mapping;
+		data = static_cast<const unsigned char*>(view);
+		size = static_cast<size_t>(file_size.QuadPart);
+#else
+		int fd = ::open(path.c_str(), O_RDONLY);
+
+		if (fd < 0)
+			return false;
+
+		struct stat file_stat;
+
+		if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+			::close(fd);
+			return false;
+		}
+
+		void* view = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		// the mapping stays valid after the descriptor is closed
+		::close(fd);
+
+		if (view == MAP_FAILED)
+			return false;
+
+		data = static_cast<const unsigned char*>(view);
+		size = static_cast<size_t>(file_stat.st_size);
+#endif
+
+		return true;
+	}
+
+	void MappedFile::close() {
+		if (!data)
+			return;
+
+#ifdef WIN32
+		UnmapViewOfFile(data);
+		CloseHandle(mapping_handle);
+		CloseHandle(file_handle);
+		file_handle = nullptr;
+		mapping_handle = nullptr;
+#else
+		munmap(const_cast<unsigned char*>(data), size);
+#endif
+
+		data = nullptr;
+		size = 0;
+	}
+
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+namespace mappedfile {
+
+	// Read-only memory mapping of a whole file. The mapping is released when the object is closed or destroyed.
+	class MappedFile {
+	public:
+		MappedFile();
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool open(const std::string& path);
+		void close();
+
+		bool isOpen() const { return data != nullptr; }
+		const unsigned char* getData() const { return data; }
+		size_t getSize() const { return size; }
+
+	private:
+		const unsigned char* data;
+		size_t size;
+
+#ifdef WIN32
+		void* file_handle;
+		void* mapping_handle;
+#endif
+	};
+
+}
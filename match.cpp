@@ -0,0 +1,593 @@
+#ifndef WIN32
+#include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#endif
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+#include "match.hpp"
+#include "board.hpp"
+#include "movegen.hpp"
+#include "attack.hpp"
+#include "constants.hpp"
+#include "util.hpp"
+#include "uci.hpp"
+
+namespace match {
+
+	// Time an engine may take beyond its clock before it loses on time, for pipe and scheduling delays
+	constexpr long TIME_MARGIN = 100;
+	// Time to answer uci and isready
+	constexpr long HANDSHAKE_TIMEOUT = 10000;
+	// Scores reported as mate, as centipawns
+	constexpr int MATE_SCORE = 30000;
+
+	double Results::score() const {
+		return games() ? (wins + 0.5 * draws) / games() : 0.5;
+	}
+
+	static double scoreToElo(double score) {
+		score = std::clamp(score, 1e-6, 1.0 - 1e-6);
+		return -400.0 * std::log10(1.0 / score - 1.0);
+	}
+
+	static double eloToScore(double elo) {
+		return 1.0 / (1.0 + std::pow(10.0, -elo / 400.0));
+	}
+
+	// Variance of the score of a single game
+	static double scoreVariance(const Results& results) {
+		double mean = results.score();
+		long games = results.games();
+
+		if (!games)
+			return 0;
+
+		return (results.wins * std::pow(1.0 - mean, 2) + results.losses * std::pow(mean, 2) + results.draws * std::pow(0.5 - mean, 2)) / games;
+	}
+
+	double Results::elo() const {
+		return scoreToElo(score());
+	}
+
+	double Results::eloMargin() const {
+		if (!games())
+			return 0;
+
+		double deviation = std::sqrt(scoreVariance(*this) / games());
+		return (scoreToElo(score() + 1.96 * deviation) - scoreToElo(score() - 1.96 * deviation)) / 2;
+	}
+
+	double Results::los() const {
+		if (wins + losses == 0)
+			return 0.5;
+
+		return 0.5 * (1.0 + std::erf((wins - losses) / std::sqrt(2.0 * (wins + losses))));
+	}
+
+	// Normal approximation of the trinomial log-likelihood ratio, as used by fishtest before pentanomial statistics
+	double Results::llr(double elo0, double elo1) const {
+		double variance = scoreVariance(*this);
+
+		if (variance <= 0)
+			return 0;
+
+		double score0 = eloToScore(elo0);
+		double score1 = eloToScore(elo1);
+
+		return games() * (score1 - score0) * (2 * score() - score0 - score1) / (2 * variance);
+	}
+
+	// A child process talking UCI over its standard input and output
+	class EngineProcess {
+	public:
+		EngineProcess() : pid(-1), to_engine(-1), from_engine(-1) {}
+		~EngineProcess() { stop(); }
+
+		EngineProcess(const EngineProcess&) = delete;
+		EngineProcess& operator=(const EngineProcess&) = delete;
+
+		bool start(const std::string& path);
+		void stop();
+		bool isRunning() const { return pid > 0; }
+		void send(const std::string& line);
+		// Reads one line, false on timeout or once the engine is gone
+		bool readLine(std::string& line, long timeout);
+
+	private:
+		int pid;
+		int to_engine;
+		int from_engine;
+		std::string buffer;
+	};
+
+#ifdef WIN32
+	bool EngineProcess::start(const std::string& path) {
+		return false;
+	}
+
+	void EngineProcess::stop() {}
+
+	void EngineProcess::send(const std::string& line) {}
+
+	bool EngineProcess::readLine(std::string& line, long timeout) {
+		return false;
+	}
+#else
+	// Engines are started one at a time, so no child inherits the pipes of another engine before they are marked close-on-exec
+	static std::mutex start_mutex;
+
+	bool EngineProcess::start(const std::string& path) {
+		std::lock_guard<std::mutex> lock(start_mutex);
+		int input[2];
+		int output[2];
+
+		if (pipe(input) != 0)
+			return false;
+
+		if (pipe(output) != 0) {
+			close(input[0]);
+			close(input[1]);
+			return false;
+		}
+
+		for (int fd : { input[0], input[1], output[0], output[1] })
+			fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+		pid = fork();
+
+		if (pid == 0) {
+			// dup2 clears close-on-exec for the standard streams
+			dup2(input[0], STDIN_FILENO);
+			dup2(output[1], STDOUT_FILENO);
+			execl(path.c_str(), path.c_str(), static_cast<char*>(nullptr));
+			_exit(127);
+		}
+
+		close(input[0]);
+		close(output[1]);
+
+		if (pid < 0) {
+			close(input[1]);
+			close(output[0]);
+			return false;
+		}
+
+		to_engine = input[1];
+		from_engine = output[0];
+		buffer.clear();
+
+		return true;
+	}
+
+	void EngineProcess::stop() {
+		if (pid <= 0)
+			return;
+
+		send("quit");
+		close(to_engine);
+
+		for (int i = 0; i < 50 && waitpid(pid, nullptr, WNOHANG) != pid; i++) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+			if (i == 49) {
+				kill(pid, SIGKILL);
+				waitpid(pid, nullptr, 0);
+			}
+		}
+
+		close(from_engine);
+		pid = -1;
+		to_engine = -1;
+		from_engine = -1;
+	}
+
+	void EngineProcess::send(const std::string& line) {
+		std::string data = line + "\n";
+		size_t written = 0;
+
+		while (written < data.size()) {
+			ssize_t count = write(to_engine, data.data() + written, data.size() - written);
+
+			// a dead engine shows up as soon as its output is read
+			if (count <= 0)
+				return;
+
+			written += count;
+		}
+	}
+
+	bool EngineProcess::readLine(std::string& line, long timeout) {
+		long deadline = util::getTimeInMs() + timeout;
+
+		while (true) {
+			size_t end = buffer.find('\n');
+
+			if (end != std::string::npos) {
+				line = buffer.substr(0, end);
+				buffer.erase(0, end + 1);
+
+				if (!line.empty() && line.back() == '\r')
+					line.pop_back();
+
+				return true;
+			}
+
+			long remaining = deadline - util::getTimeInMs();
+
+			if (remaining <= 0)
+				return false;
+
+			pollfd fd = { from_engine, POLLIN, 0 };
+
+			if (poll(&fd, 1, static_cast<int>(remaining)) <= 0)
+				return false;
+
+			char chunk[4096];
+			ssize_t count = read(from_engine, chunk, sizeof(chunk));
+
+			if (count <= 0)
+				return false;
+
+			buffer.append(chunk, count);
+		}
+	}
+#endif
+
+	static std::string executablePath(const std::string& path) {
+#ifndef WIN32
+		if (path == "self") {
+			char buffer[4096];
+			ssize_t length = readlink("/proc/self/exe", buffer, sizeof(buffer) - 1);
+
+			if (length > 0)
+				return std::string(buffer, length);
+		}
+#endif
+		return path;
+	}
+
+	static bool waitFor(EngineProcess& engine, const std::string& token, long timeout) {
+		long deadline = util::getTimeInMs() + timeout;
+		std::string line;
+
+		while (engine.readLine(line, deadline - util::getTimeInMs())) {
+			if (line == token)
+				return true;
+		}
+
+		return false;
+	}
+
+	static bool startEngine(EngineProcess& engine, const EngineConfig& config) {
+		engine.stop();
+
+		if (!engine.start(executablePath(config.path)))
+			return false;
+
+		engine.send("uci");
+
+		if (!waitFor(engine, "uciok", HANDSHAKE_TIMEOUT)) {
+			engine.stop();
+			return false;
+		}
+
+		for (const auto& [name, value] : config.options)
+			engine.send("setoption name " + name + " value " + value);
+
+		return true;
+	}
+
+	// Starts the engine if needed and waits until it is ready for a new game
+	static bool prepareEngine(EngineProcess& engine, const EngineConfig& config) {
+		if (!engine.isRunning() && !startEngine(engine, config))
+			return false;
+
+		engine.send("ucinewgame");
+		engine.send("isready");
+
+		if (!waitFor(engine, "readyok", HANDSHAKE_TIMEOUT)) {
+			engine.stop();
+			return false;
+		}
+
+		return true;
+	}
+
+	// The legal move with the given UCI notation, or a null move
+	static move::Move findMove(board::BoardState& state, const std::string& move_string) {
+		move::Move move;
+
+		try {
+			move = uci::parseMove(state, move_string);
+		}
+		catch (const std::runtime_error&) {
+			return {};
+		}
+
+		if (!state.step(move))
+			return {};
+
+		state.undo();
+		return move;
+	}
+
+	// Reads the score from an info line, from the point of view of the engine
+	static bool parseScore(const std::string& line, int& score) {
+		std::istringstream stream(line);
+		std::string token;
+
+		while (stream >> token) {
+			if (token != "score")
+				continue;
+
+			std::string type;
+			int value;
+
+			if (!(stream >> type >> value))
+				return false;
+
+			if (type == "cp")
+				score = value;
+			else if (type == "mate")
+				score = value > 0 ? MATE_SCORE - value : -MATE_SCORE - value;
+			else
+				return false;
+
+			return true;
+		}
+
+		return false;
+	}
+
+	// Normalizes an opening line to a six field FEN, EPD lines have no move counters
+	static std::string openingFen(const std::string& line) {
+		std::istringstream stream(line);
+		std::vector<std::string> fields;
+		std::string field;
+
+		while (fields.size() < 6 && stream >> field)
+			fields.push_back(field);
+
+		if (fields.size() < 4)
+			return "";
+
+		bool has_counters = fields.size() == 6 && std::isdigit(fields[4][0]) && std::isdigit(fields[5][0]);
+		return fields[0] + " " + fields[1] + " " + fields[2] + " " + fields[3] + (has_counters ? " " + fields[4] + " " + fields[5] : " 0 1");
+	}
+
+	// Plays one game between the engines for white and black. Returns the result from white's point of view: 1, 0 or -1.
+	static int playGame(EngineProcess* players[2], const EngineConfig* configs[2], const std::string& opening, const Options& options) {
+		for (int side = 0; side < 2; side++) {
+			if (!prepareEngine(*players[side], *configs[side]))
+				return side == asInt(constants::Color::WHITE) ? -1 : 1;
+		}
+
+		board::BoardState state;
+		state.loadFromFen(opening);
+
+		std::string position = opening == constants::FEN_START_POS ? "position startpos" : "position fen " + opening;
+		std::string moves;
+		long clocks[2] = { options.base_time, options.base_time };
+
+		int resign_count = 0;
+		int resign_sign = 0;
+		int draw_count = 0;
+
+		for (int ply = 0; ; ply++) {
+			if (!movegen::hasLegalMove(state)) {
+				if (!attack::isInCheck(state))
+					return 0;
+
+				return state.player == constants::Color::WHITE ? -1 : 1;
+			}
+
+			if (state.fifty_move >= 100 || state.repetitionCount() >= 2 || state.isInsufficientMaterial() || ply >= options.max_plies)
+				return 0;
+
+			int side = asInt(state.player);
+			int loss = side == asInt(constants::Color::WHITE) ? -1 : 1;
+			EngineProcess& engine = *players[side];
+
+			engine.send(position + (moves.empty() ? "" : " moves" + moves));
+			engine.send("go wtime " + std::to_string(clocks[0]) + " btime " + std::to_string(clocks[1])
+				+ " winc " + std::to_string(options.increment) + " binc " + std::to_string(options.increment));
+
+			long start_time = util::getTimeInMs();
+			std::string line;
+			std::string best_move;
+			int score = 0;
+			bool has_score = false;
+
+			while (engine.readLine(line, clocks[side] + TIME_MARGIN - (util::getTimeInMs() - start_time))) {
+				if (line.rfind("bestmove ", 0) == 0) {
+					best_move = util::splitString(line, " ")[1];
+					break;
+				}
+
+				if (line.rfind("info ", 0) == 0 && parseScore(line, score))
+					has_score = true;
+			}
+
+			long elapsed = util::getTimeInMs() - start_time;
+
+			// lost on time or crashed, the engine may still be searching, so the next game starts a new one
+			if (best_move.empty() || elapsed > clocks[side] + TIME_MARGIN) {
+				engine.stop();
+				return loss;
+			}
+
+			clocks[side] += options.increment - elapsed;
+
+			move::Move move = findMove(state, best_move);
+
+			if (move.isNull())
+				return loss;
+
+			state.step(move);
+			moves += " " + best_move;
+
+			if (!has_score) {
+				resign_count = 0;
+				draw_count = 0;
+				continue;
+			}
+
+			int white_score = side == asInt(constants::Color::WHITE) ? score : -score;
+			int sign = white_score > 0 ? 1 : -1;
+
+			if (std::abs(white_score) >= options.resign_score && (resign_count == 0 || sign == resign_sign)) {
+				resign_sign = sign;
+
+				if (++resign_count >= options.resign_plies)
+					return sign;
+			}
+			else {
+				resign_count = 0;
+			}
+
+			if (ply >= options.draw_ply && std::abs(white_score) <= options.draw_score) {
+				if (++draw_count >= options.draw_plies)
+					return 0;
+			}
+			else {
+				draw_count = 0;
+			}
+		}
+	}
+
+	struct Shared {
+		std::mutex mutex;
+		Results results;
+		std::atomic<long> next_game = 0;
+		std::atomic<bool> done = false;
+	};
+
+	static void printResults(const Results& results, const Options& options) {
+		std::cout << "info string match games " << results.games() << " +" << results.wins << " -" << results.losses << " =" << results.draws
+			<< std::fixed << std::setprecision(1)
+			<< " elo " << results.elo() << " +- " << results.eloMargin()
+			<< " los " << 100 * results.los() << "%"
+			<< std::setprecision(2)
+			<< " llr " << results.llr(options.elo0, options.elo1)
+			<< " (" << std::log(options.beta / (1 - options.alpha)) << ", " << std::log((1 - options.beta) / options.alpha) << ")"
+			<< std::defaultfloat << std::endl;
+	}
+
+	static void playGames(const Options& options, const std::vector<std::string>& openings, Shared& shared) {
+		EngineProcess engines[2];
+		double lower_bound = std::log(options.beta / (1 - options.alpha));
+		double upper_bound = std::log((1 - options.beta) / options.alpha);
+
+		while (!shared.done) {
+			long game = shared.next_game++;
+
+			if (game >= options.games)
+				break;
+
+			// every opening is played twice, engine 1 has white in the first game of the pair
+			const std::string& opening = openings[(game / 2) % openings.size()];
+			int first_color = game % 2;
+
+			EngineProcess* players[2];
+			const EngineConfig* configs[2];
+			players[first_color] = &engines[0];
+			configs[first_color] = &options.engines[0];
+			players[first_color ^ 1] = &engines[1];
+			configs[first_color ^ 1] = &options.engines[1];
+
+			int white_result = playGame(players, configs, opening, options);
+			int result = first_color == asInt(constants::Color::WHITE) ? white_result : -white_result;
+
+			std::lock_guard<std::mutex> lock(shared.mutex);
+
+			if (result > 0)
+				shared.results.wins++;
+			else if (result < 0)
+				shared.results.losses++;
+			else
+				shared.results.draws++;
+
+			printResults(shared.results, options);
+
+			double llr = shared.results.llr(options.elo0, options.elo1);
+
+			if (llr >= upper_bound || llr <= lower_bound)
+				shared.done = true;
+		}
+	}
+
+	Results run(const Options& options) {
+#ifdef WIN32
+		std::cout << "info string match can only start engines on POSIX systems" << std::endl;
+		return {};
+#else
+		// writing to an engine that died must not end this process
+		signal(SIGPIPE, SIG_IGN);
+#endif
+
+		std::vector<std::string> openings;
+
+		if (!options.openings.empty()) {
+			std::ifstream file(options.openings);
+			std::string line;
+
+			if (!file)
+				std::cout << "info string Could not open " << options.openings << std::endl;
+
+			while (std::getline(file, line)) {
+				std::string fen = openingFen(line);
+
+				if (fen.empty())
+					continue;
+
+				// skip lines that aren't positions
+				try {
+					board::BoardState state;
+					state.loadFromFen(fen);
+					openings.push_back(fen);
+				}
+				catch (const std::logic_error&) {}
+			}
+		}
+
+		if (openings.empty())
+			openings.push_back(constants::FEN_START_POS);
+
+		Shared shared;
+		std::vector<std::thread> threads;
+
+		for (int i = 0; i < options.concurrency; i++)
+			threads.emplace_back(playGames, std::cref(options), std::cref(openings), std::ref(shared));
+
+		for (auto& thread : threads)
+			thread.join();
+
+		double llr = shared.results.llr(options.elo0, options.elo1);
+		std::cout << "info string match finished, ";
+
+		if (llr >= std::log((1 - options.beta) / options.alpha))
+			std::cout << "H1 accepted (elo >= " << options.elo1 << ")" << std::endl;
+		else if (llr <= std::log(options.beta / (1 - options.alpha)))
+			std::cout << "H0 accepted (elo <= " << options.elo0 << ")" << std::endl;
+		else
+			std::cout << "SPRT inconclusive" << std::endl;
+
+		printResults(shared.results, options);
+
+		return shared.results;
+	}
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+
+namespace match {
+
+	// A UCI engine binary with the options sent to it before the first game.
+	// The path "self" starts this engine again.
+	struct EngineConfig {
+		std::string path = "self";
+		std::vector<std::pair<std::string, std::string>> options;
+	};
+
+	struct Options {
+		EngineConfig engines[2];
+		long games = 100;
+		int concurrency = 1;
+		long base_time = 10000; // ms
+		long increment = 100; // ms
+		// one FEN or EPD per line, each opening is played twice with colours reversed
+		std::string openings;
+
+		// SPRT of engine 1 against engine 2
+		double elo0 = 0;
+		double elo1 = 5;
+		double alpha = 0.05;
+		double beta = 0.05;
+
+		// both engines agree on a score of at least resign_score for resign_plies plies
+		int resign_score = 1000;
+		int resign_plies = 6;
+		// after draw_ply, both engines report scores within draw_score for draw_plies plies
+		int draw_ply = 80;
+		int draw_score = 10;
+		int draw_plies = 12;
+		int max_plies = 600;
+	};
+
+	// Win, loss and draw counts of engine 1
+	struct Results {
+		long wins = 0;
+		long losses = 0;
+		long draws = 0;
+
+		long games() const { return wins + losses + draws; }
+		double score() const;
+		double elo() const;
+		// half width of the 95% confidence interval of elo()
+		double eloMargin() const;
+		// likelihood of superiority
+		double los() const;
+		// log-likelihood ratio of elo1 against elo0
+		double llr(double elo0, double elo1) const;
+	};
+
+	// Plays options.games games on options.concurrency threads, each thread running both engines as
+	// child processes. Stops early once the SPRT accepts either hypothesis.
+	Results run(const Options& options);
+
+}
@@ -0,0 +1,99 @@
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include <new>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "memory.hpp"
+#include "threadbinding.hpp"
+
+namespace memory {
+
+	// below this many elements per thread, starting threads costs more than it saves
+	constexpr size_t MIN_SLICE = 1 << 16;
+
+	static size_t roundUp(size_t bytes) {
+		return (bytes + LARGE_PAGE_SIZE - 1) / LARGE_PAGE_SIZE * LARGE_PAGE_SIZE;
+	}
+
+	void* allocateLarge(size_t bytes) {
+		bytes = roundUp(std::max<size_t>(bytes, 1));
+
+#if defined(WIN32)
+		// needs the lock pages in memory privilege, without it fall back to normal pages
+		SIZE_T large_page = GetLargePageMinimum();
+
+		if (large_page && bytes % large_page == 0) {
+			void* memory = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+
+			if (memory)
+				return memory;
+		}
+
+		void* memory = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+
+		if (!memory)
+			throw std::bad_alloc();
+
+		return memory;
+#elif defined(__linux__)
+		// pages reserved with vm.nr_hugepages first, then transparent huge pages
+		void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+		if (memory != MAP_FAILED)
+			return memory;
+
+		memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		if (memory == MAP_FAILED)
+			throw std::bad_alloc();
+
+		madvise(memory, bytes, MADV_HUGEPAGE);
+		return memory;
+#else
+		return ::operator new(bytes, std::align_val_t(LARGE_PAGE_SIZE));
+#endif
+	}
+
+	void freeLarge(void* memory, size_t bytes) {
+		if (!memory)
+			return;
+
+#if defined(WIN32)
+		VirtualFree(memory, 0, MEM_RELEASE);
+#elif defined(__linux__)
+		munmap(memory, roundUp(std::max<size_t>(bytes, 1)));
+#else
+		::operator delete(memory, std::align_val_t(LARGE_PAGE_SIZE));
+#endif
+	}
+
+	void parallelFor(size_t count, const std::function<void(size_t, size_t)>& work) {
+		size_t thread_count = std::clamp<size_t>(count / MIN_SLICE, 1, std::max(1u, std::thread::hardware_concurrency()));
+
+		if (thread_count == 1) {
+			work(0, count);
+			return;
+		}
+
+		std::vector<std::thread> threads;
+		size_t slice = (count + thread_count - 1) / thread_count;
+
+		// with ThreadBinding, slice i is first touched from the CPU of worker i and so lives on its NUMA node
+		for (size_t begin = 0; begin < count; begin += slice) {
+			threads.emplace_back([&work, begin, end = std::min(begin + slice, count), index = static_cast<int>(threads.size())]() {
+				threadbinding::bindThisThread(index);
+				work(begin, end);
+			});
+		}
+
+		for (auto& thread : threads)
+			thread.join();
+	}
+
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <memory>
+#include <functional>
+#include <type_traits>
+#include <cstddef>
+
+namespace memory {
+
+	constexpr size_t LARGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+	// Memory for big tables, backed by 2 MB pages where the system gives them out, since a table of several GB
+	// in 4 KB pages misses the TLB on nearly every probe. The pages are left untouched, so on NUMA machines each
+	// page lands on the node of the thread that first writes it. Throws std::bad_alloc.
+	void* allocateLarge(size_t bytes);
+	void freeLarge(void* memory, size_t bytes);
+
+	template <typename T>
+	struct LargeDeleter {
+		size_t bytes;
+
+		void operator()(T* memory) const {
+			freeLarge(memory, bytes);
+		}
+	};
+
+	template <typename T>
+	using LargeArray = std::unique_ptr<T[], LargeDeleter<T>>;
+
+	// No constructors run, the caller initializes the elements, preferably with parallelFor
+	template <typename T>
+	LargeArray<T> makeLargeArray(size_t count) {
+		static_assert(std::is_trivially_destructible_v<T>, "large arrays are released without destructors");
+		size_t bytes = count * sizeof(T);
+		return LargeArray<T>(static_cast<T*>(allocateLarge(bytes)), LargeDeleter<T>{ bytes });
+	}
+
+	// Splits [0, count) into one slice per hardware thread and runs work(begin, end) on each of them in parallel.
+	// Small ranges run on the calling thread.
+	void parallelFor(size_t count, const std::function<void(size_t, size_t)>& work);
+
+}
@@ -27,7 +27,7 @@ constexpr std::array<constants::Piece, 3> BLACK_NON_SLIDING_PIECES = { constants
 																	   constants::Piece::bK };
 
 
-static void addWhitePawnCaptureMove(int from, int to, int capture, std::vector<move::Move>& list, board::BoardState state) {
+static void addWhitePawnCaptureMove(int from, int to, int capture, std::vector<move::Move>& list, board::BoardState& state) {
 
 	assert(validate::isPieceValid(capture));
 	assert(validate::is120OnBoard(from));
@@ -46,7 +46,7 @@ static void addWhitePawnCaptureMove(int from, int to, int capture, std::vector<m
 	}
 }
 
-static void addWhitePawnMove(int from, int to, std::vector<move::Move>& list, board::BoardState& state) {
+static void addWhitePawnMove(int from, int to, std::vector<move::Move>& list) {
 
 	assert(validate::is120OnBoard(from));
 	assert(validate::is120OnBoard(to));
@@ -60,17 +60,6 @@ static void addWhitePawnMove(int from, int to, std::vector<move::Move>& list, bo
 	else {
 		list.push_back(move::Move(from, to, 0, false, false, 0, false, 0));
 	}
-
-	int priority = 0;
-
-	if (state.search_killers[0][state.ply] == list.back())
-		priority = 900000;
-	else if (state.search_killers[1][state.ply] == list.back())
-		priority = 800000;
-	else
-		priority = state.search_history[state.pieces[from]][to];
-
-	list.back().score = priority;
 }
 
 static void addBlackPawnCaptureMove(int from, int to, int capture, std::vector<move::Move>& list, board::BoardState& state) {
@@ -93,7 +82,7 @@ static void addBlackPawnCaptureMove(int from, int to, int capture, std::vector<m
 	}
 }
 
-static void addBlackPawnMove(int from, int to, std::vector<move::Move>& list, board::BoardState& state) {
+static void addBlackPawnMove(int from, int to, std::vector<move::Move>& list) {
 	assert(validate::is120OnBoard(from));
 	assert(validate::is120OnBoard(to));
 
@@ -107,34 +96,14 @@ static void addBlackPawnMove(int from, int to, std::vector<move::Move>& list, bo
 	else {
 		list.push_back(move::Move(from, to, 0, false, false, 0, false, 0));
 	}
-
-	int priority = 0;
-
-	if (state.search_killers[0][state.ply] == list.back())
-		priority = 900000;
-	else if (state.search_killers[1][state.ply] == list.back())
-		priority = 800000;
-	else
-		priority = state.search_history[state.pieces[from]][to];
-
-	list.back().score = priority;
 }
 
-static void addQuietMove(int from, int to, std::vector<move::Move>& list, board::BoardState& state) {
+static void addQuietMove(int from, int to, std::vector<move::Move>& list) {
 	assert(validate::is120OnBoard(from));
 	assert(validate::is120OnBoard(to));
 
-	int priority = 0;
+	// quiet moves are scored by the search, which owns the killers and history
 	list.push_back(move::Move(from, to, 0, false, false, 0, false, 0));
-
-	if (state.search_killers[0][state.ply] == list.back())
-		priority = 900000;
-	else if (state.search_killers[1][state.ply] == list.back())
-		priority = 800000;
-	else
-		priority = state.search_history[state.pieces[from]][to];;
-
-	list.back().score = priority;
 }
 
 static void addCaptureMove(int from, int to, int capture, std::vector<move::Move>& list, board::BoardState& state) {
@@ -183,7 +152,7 @@ std::vector<move::Move> movegen::generateAllMoves(board::BoardState& state) {
 			assert(validate::is120OnBoard(wp_square));
 
 			if (state.pieces[wp_square + constants::DIR_UP] == asInt(constants::Piece::EMPTY)) {
-				addWhitePawnMove(wp_square, wp_square + constants::DIR_UP, result, state);
+				addWhitePawnMove(wp_square, wp_square + constants::DIR_UP, result);
 
 				if (util::_120ToRow(wp_square) == asInt(constants::Rank::_2) &&
 					state.pieces[wp_square + 2 * constants::DIR_UP] == asInt(constants::Piece::EMPTY)) {
@@ -239,7 +208,7 @@ std::vector<move::Move> movegen::generateAllMoves(board::BoardState& state) {
 			assert(validate::is120OnBoard(wp_square));
 
 			if (state.pieces[wp_square + constants::DIR_DOWN] == asInt(constants::Piece::EMPTY)) {
-				addBlackPawnMove(wp_square, wp_square + constants::DIR_DOWN, result, state);
+				addBlackPawnMove(wp_square, wp_square + constants::DIR_DOWN, result);
 
 				if (util::_120ToRow(wp_square) == asInt(constants::Rank::_7) &&
 					state.pieces[wp_square + 2 * constants::DIR_DOWN] == asInt(constants::Piece::EMPTY)) {
@@ -283,7 +252,7 @@ std::vector<move::Move> movegen::generateAllMoves(board::BoardState& state) {
 
 
 					if (state.pieces[_square] == asInt(constants::Piece::EMPTY)) {
-						addQuietMove(piece_square, _square, result, state);
+						addQuietMove(piece_square, _square, result);
 					}
 					// BLACK ^ 1 == WHITE, WHITE ^ 1 == BLACK
 					else if (asInt(constants::PIECE_COLOR[state.pieces[_square]]) == (asInt(state.player) ^ 1)) {
@@ -312,7 +281,7 @@ std::vector<move::Move> movegen::generateAllMoves(board::BoardState& state) {
 				if (state.pieces[_square] == asInt(constants::Square::OFFBOARD)) continue;
 
 				if (state.pieces[_square] == asInt(constants::Piece::EMPTY)) {
-					addQuietMove(piece_square, _square, result, state);
+					addQuietMove(piece_square, _square, result);
 				}
 				// BLACK ^ 1 == WHITE, WHITE ^ 1 == BLACK
 				else if (asInt(constants::PIECE_COLOR[state.pieces[_square]]) == (asInt(state.player) ^ 1)) {
@@ -344,6 +313,17 @@ bool movegen::moveExists(board::BoardState& state, const move::Move& test_move)
 	return false;
 }
 
+bool movegen::hasLegalMove(board::BoardState& state) {
+	for (const auto& move : generateAllMoves(state)) {
+		if (state.step(move)) {
+			state.undo();
+			return true;
+		}
+	}
+
+	return false;
+}
+
 
 std::vector<move::Move> movegen::generateAllCaptures(board::BoardState& state) {
 	std::vector<move::Move> result;
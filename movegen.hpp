@@ -14,4 +14,6 @@ namespace movegen {
 	std::vector<move::Move> generateAllMoves(board::BoardState& state);
 	std::vector<move::Move> generateAllCaptures(board::BoardState& state);
 	bool moveExists(board::BoardState& state, const move::Move& move);
+	// false for checkmate and stalemate
+	bool hasLegalMove(board::BoardState& state);
 }
\ No newline at end of file
@@ -0,0 +1,327 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <cstring>
+#include <algorithm>
+
+#include "board.hpp"
+#include "attack.hpp"
+#include "constants.hpp"
+#include "mappedfile.hpp"
+#include "gensfen.hpp"
+#include "san.hpp"
+#include "util.hpp"
+
+// Extracts training positions from PGN files.
+//
+// The file is memory mapped and split into one chunk per thread at game boundaries (lines starting with [Event).
+// Every thread replays the games of its chunk with BoardState and writes the positions that pass the filters,
+// so the output isn't in the order of the input. Games without a result are skipped.
+//
+// Usage: pgn <input> <output> [format fen|packed] [min_ply n] [max_ply n] [quiet true] [threads n]
+// fen writes one FEN per line followed by the result from white's point of view, the dataset format of tune.
+// packed appends 32 byte positions in the gensfen format, with a score of 0. min_ply skips the opening book part
+// of the games, and quiet keeps only positions that aren't in check and whose move isn't a capture or promotion.
+namespace pgn {
+
+	// positions collected by a thread before they are written out
+	constexpr size_t BUFFER_SIZE = 1 << 20;
+
+	struct Options {
+		std::string input;
+		std::string output;
+		bool packed = false;
+		int min_ply = 0;
+		int max_ply = 1000;
+		bool quiet = false;
+		int threads = 1;
+	};
+
+	struct Game {
+		std::string fen = constants::FEN_START_POS;
+		// from white's point of view, 2 while unknown
+		int result = 2;
+		std::vector<std::string> moves;
+	};
+
+	struct Shared {
+		std::ofstream file;
+		std::mutex file_mutex;
+		std::atomic<long> games = 0;
+		std::atomic<long> positions = 0;
+		std::atomic<long> bad_games = 0;
+	};
+
+	static void flush(Shared& shared, std::string& buffer) {
+		std::lock_guard<std::mutex> lock(shared.file_mutex);
+		shared.file.write(buffer.data(), buffer.size());
+		buffer.clear();
+	}
+
+	static void writePosition(const board::BoardState& state, int white_result, const Options& options, std::string& buffer) {
+		if (options.packed) {
+			int result = state.player == constants::Color::WHITE ? white_result : -white_result;
+			gensfen::PackedPosition packed = gensfen::pack(state, 0, result);
+			buffer.append(reinterpret_cast<const char*>(packed.data()), packed.size());
+			return;
+		}
+
+		buffer += state.toFen();
+		buffer += white_result > 0 ? " 1-0\n" : white_result < 0 ? " 0-1\n" : " 1/2-1/2\n";
+	}
+
+	// Replays the game and writes the positions before every move that pass the filters.
+	// Returns false if a move couldn't be played, the positions up to it are kept.
+	static bool replayGame(board::BoardState& state, const Game& game, const Options& options, std::string& buffer, long& positions) {
+		try {
+			state.loadFromFen(game.fen);
+		}
+		catch (const std::logic_error&) {
+			return false;
+		}
+
+		for (int ply = 0; ply < static_cast<int>(game.moves.size()) && ply <= options.max_ply; ply++) {
+			move::Move move = san::parseSan(state, game.moves[ply]);
+
+			if (move.isNull())
+				return false;
+
+			bool quiet = !move.captured && !move.en_passant && !move.promoted_piece && !attack::isInCheck(state);
+
+			if (ply >= options.min_ply && (!options.quiet || quiet)) {
+				writePosition(state, game.result, options, buffer);
+				positions++;
+			}
+
+			state.step(move);
+		}
+
+		return true;
+	}
+
+	static void readTag(const std::string& tag, Game& game) {
+		size_t name_end = tag.find(' ');
+		size_t value_begin = tag.find('"');
+		size_t value_end = tag.rfind('"');
+
+		if (name_end == std::string::npos || value_begin == std::string::npos || value_end <= value_begin)
+			return;
+
+		std::string name = tag.substr(0, name_end);
+		std::string value = tag.substr(value_begin + 1, value_end - value_begin - 1);
+
+		if (name == "FEN")
+			game.fen = value;
+		else if (name == "Result")
+			game.result = value == "1-0" ? 1 : value == "0-1" ? -1 : value == "1/2-1/2" ? 0 : 2;
+	}
+
+	// Adds a movetext token to the game, skipping move numbers, NAGs and the result
+	static void readToken(const std::string& token, Game& game) {
+		if (token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*" || token[0] == '$')
+			return;
+
+		// 12. and 12... , possibly glued to the move as in 12.e4
+		size_t start = 0;
+
+		while (start < token.size() && (std::isdigit(token[start]) || token[start] == '.'))
+			start++;
+
+		if (start > 0 && (start == token.size() || token[start - 1] == '.')) {
+			if (start < token.size())
+				game.moves.push_back(token.substr(start));
+			return;
+		}
+
+		game.moves.push_back(token);
+	}
+
+	static void processChunk(const char* begin, const char* end, const Options& options, Shared& shared) {
+		board::BoardState state;
+		std::string buffer;
+		Game game;
+		bool in_movetext = false;
+		long positions = 0;
+
+		auto finishGame = [&]() {
+			if (game.result != 2 && !game.moves.empty()) {
+				long game_positions = 0;
+
+				if (!replayGame(state, game, options, buffer, game_positions))
+					shared.bad_games++;
+
+				positions += game_positions;
+				shared.games++;
+			}
+
+			game = Game();
+			in_movetext = false;
+
+			if (buffer.size() >= BUFFER_SIZE)
+				flush(shared, buffer);
+		};
+
+		const char* c = begin;
+
+		while (c < end) {
+			if (std::isspace(static_cast<unsigned char>(*c))) {
+				c++;
+			}
+			else if (*c == '[') {
+				if (in_movetext)
+					finishGame();
+
+				const char* tag_end = std::find(c, end, ']');
+				readTag(std::string(c + 1, tag_end), game);
+				c = tag_end + (tag_end < end);
+			}
+			else if (*c == '{') {
+				c = std::find(c, end, '}');
+				c += c < end;
+			}
+			else if (*c == ';' || (*c == '%' && (c == begin || c[-1] == '\n'))) {
+				c = std::find(c, end, '\n');
+			}
+			else if (*c == '(') {
+				// variations nest and may contain comments with parentheses
+				int depth = 0;
+
+				while (c < end) {
+					if (*c == '{') {
+						c = std::find(c, end, '}');
+
+						if (c == end)
+							break;
+					}
+					else if (*c == '(') {
+						depth++;
+					}
+					else if (*c == ')' && --depth == 0) {
+						c++;
+						break;
+					}
+
+					c++;
+				}
+			}
+			else {
+				const char* token_end = c;
+
+				while (token_end < end && !std::isspace(static_cast<unsigned char>(*token_end)) && !std::strchr("{}();[", *token_end))
+					token_end++;
+
+				// a stray closing brace or parenthesis
+				if (token_end == c) {
+					c++;
+					continue;
+				}
+
+				readToken(std::string(c, token_end), game);
+				in_movetext = true;
+				c = token_end;
+			}
+		}
+
+		finishGame();
+		flush(shared, buffer);
+		shared.positions += positions;
+	}
+
+	// Start of the first game at or after position, the file end if there is none
+	static const char* nextGame(const char* data, const char* position, const char* end) {
+		const char* tag = "[Event ";
+
+		for (const char* c = position; c < end;) {
+			if ((c == data || c[-1] == '\n') && end - c >= 7 && std::memcmp(c, tag, 7) == 0)
+				return c;
+
+			c = std::find(c, end, '\n');
+			c += c < end;
+		}
+
+		return end;
+	}
+
+	static bool extract(const Options& options) {
+		mappedfile::MappedFile input;
+
+		if (!input.open(options.input)) {
+			std::cout << "Could not open " << options.input << std::endl;
+			return false;
+		}
+
+		Shared shared;
+		shared.file.open(options.output, options.packed ? std::ios::binary | std::ios::app : std::ios::out);
+
+		if (!shared.file) {
+			std::cout << "Could not open " << options.output << std::endl;
+			return false;
+		}
+
+		const char* data = reinterpret_cast<const char*>(input.getData());
+		const char* end = data + input.getSize();
+		long start_time = util::getTimeInMs();
+
+		// the first chunk also takes anything before the first [Event tag
+		std::vector<const char*> bounds = { data };
+
+		for (int i = 1; i < options.threads; i++)
+			bounds.push_back(std::max(bounds.back(), nextGame(data, data + input.getSize() * i / options.threads, end)));
+
+		bounds.push_back(end);
+
+		std::vector<std::thread> threads;
+
+		for (int i = 0; i < options.threads; i++)
+			threads.emplace_back(processChunk, bounds[i], bounds[i + 1], std::cref(options), std::ref(shared));
+
+		for (auto& thread : threads)
+			thread.join();
+
+		std::cout << shared.games << " games, " << shared.positions << " positions written to " << options.output << " in "
+			<< (util::getTimeInMs() - start_time) / 1000.0 << " s";
+
+		if (shared.bad_games)
+			std::cout << ", " << shared.bad_games << " games stopped at an illegal or unreadable move";
+
+		std::cout << std::endl;
+		return static_cast<bool>(shared.file);
+	}
+
+}
+
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		std::cout << "Usage: pgn <input> <output> [format fen|packed] [min_ply n] [max_ply n] [quiet true] [threads n]" << std::endl;
+		return 1;
+	}
+
+	pgn::Options options;
+	options.input = argv[1];
+	options.output = argv[2];
+	options.threads = std::max(1u, std::thread::hardware_concurrency());
+
+	try {
+		for (int i = 3; i + 1 < argc; i += 2) {
+			std::string name = argv[i];
+			std::string value = argv[i + 1];
+
+			if (name == "format") { options.packed = value == "packed"; }
+			else if (name == "min_ply") { options.min_ply = std::stoi(value); }
+			else if (name == "max_ply") { options.max_ply = std::stoi(value); }
+			else if (name == "quiet") { options.quiet = value == "true"; }
+			else if (name == "threads") { options.threads = std::max(1, std::stoi(value)); }
+			else { std::cout << "Unknown parameter " << name << std::endl; }
+		}
+	}
+	catch (const std::logic_error&) {
+		std::cout << "Invalid parameter" << std::endl;
+		return 1;
+	}
+
+	return pgn::extract(options) ? 0 : 1;
+}
@@ -0,0 +1,129 @@
+#include <fstream>
+#include <cstring>
+#include <cinttypes>
+
+#include "pvtable.hpp"
+#include "mappedfile.hpp"
+#include "constants.hpp"
+
+namespace pvtable {
+
+	// A hash file is a header followed by entry_count entries, in the byte order of the machine that wrote it.
+	// The key fingerprint is the key of the start position, so files from builds whose Zobrist keys differ
+	// (another seed, random engine or byte order) are refused instead of filling the table with wrong moves.
+	// Only moves and depths are kept, scores depend on the evaluation of the build that searched them.
+	constexpr char FILE_MAGIC[8] = { 'P', 'V', 'T', 'A', 'B', 'L', 'E', '\0' };
+	constexpr uint32_t FILE_VERSION = 1;
+
+	struct FileHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t entry_size;
+		uint64_t random_seed;
+		uint64_t key_fingerprint;
+		uint64_t entry_count;
+	};
+
+	struct FileEntry {
+		uint64_t position_key;
+		uint8_t from;
+		uint8_t to;
+		uint8_t captured;
+		uint8_t promoted_piece;
+		// bit 0 en passant, bit 1 pawn start, bit 2 castle
+		uint8_t flags;
+		uint8_t depth;
+		uint8_t padding[2];
+	};
+
+	static_assert(sizeof(FileHeader) == 40 && sizeof(FileEntry) == 16, "hash file layout");
+
+	static uint64_t keyFingerprint() {
+		board::BoardState state;
+		state.loadFromFen(constants::FEN_START_POS);
+		return state.position_key;
+	}
+
+	static FileHeader expectedHeader() {
+		FileHeader header = {};
+		std::memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+		header.version = FILE_VERSION;
+		header.entry_size = sizeof(FileEntry);
+		header.random_seed = constants::RANDOM_SEED;
+		header.key_fingerprint = keyFingerprint();
+		return header;
+	}
+
+	bool PVTable::save(const std::string& path) const {
+		std::ofstream file(path, std::ios::binary);
+
+		if (!file)
+			return false;
+
+		FileHeader header = expectedHeader();
+
+		for (size_t i = 0; i < size; i++)
+			header.entry_count += !data[i].move.isNull();
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		for (size_t i = 0; i < size; i++) {
+			const Entry& entry = data[i];
+
+			if (entry.move.isNull())
+				continue;
+
+			FileEntry file_entry = {};
+			file_entry.position_key = entry.position_key;
+			file_entry.from = static_cast<uint8_t>(entry.move.from);
+			file_entry.to = static_cast<uint8_t>(entry.move.to);
+			file_entry.captured = static_cast<uint8_t>(entry.move.captured);
+			file_entry.promoted_piece = static_cast<uint8_t>(entry.move.promoted_piece);
+			file_entry.flags = entry.move.en_passant | entry.move.pawn_start << 1 | entry.move.is_castle << 2;
+			file_entry.depth = static_cast<uint8_t>(std::clamp(entry.depth, 0, 255));
+
+			file.write(reinterpret_cast<const char*>(&file_entry), sizeof(file_entry));
+		}
+
+		return static_cast<bool>(file);
+	}
+
+	bool PVTable::load(const std::string& path, bool merge) {
+		mappedfile::MappedFile file;
+
+		if (!file.open(path) || file.getSize() < sizeof(FileHeader))
+			return false;
+
+		FileHeader header;
+		FileHeader expected = expectedHeader();
+		std::memcpy(&header, file.getData(), sizeof(header));
+
+		if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 || header.version != expected.version
+			|| header.entry_size != expected.entry_size || header.random_seed != expected.random_seed
+			|| header.key_fingerprint != expected.key_fingerprint
+			|| file.getSize() != sizeof(FileHeader) + header.entry_count * sizeof(FileEntry))
+			return false;
+
+		if (!merge)
+			clear();
+
+		const unsigned char* entries = file.getData() + sizeof(FileHeader);
+
+		for (uint64_t i = 0; i < header.entry_count; i++) {
+			FileEntry file_entry;
+			std::memcpy(&file_entry, entries + i * sizeof(FileEntry), sizeof(file_entry));
+
+			Entry& slot = data[file_entry.position_key % size];
+
+			if (!slot.move.isNull() && slot.depth > file_entry.depth)
+				continue;
+
+			move::Move move(file_entry.from, file_entry.to, file_entry.captured, file_entry.flags & 1, file_entry.flags >> 1 & 1,
+				file_entry.promoted_piece, file_entry.flags >> 2 & 1, 0);
+			slot = Entry(file_entry.position_key, move, file_entry.depth, 0, Bound::NONE, generation);
+		}
+
+		return true;
+	}
+
+}
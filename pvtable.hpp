@@ -1,46 +1,104 @@
 #pragma once
 
 #include <memory>
+#include <algorithm>
+#include <new>
 #include <stdexcept>
+#include <string>
 
 #include "move.hpp"
 #include "board.hpp"
 #include "movegen.hpp"
 #include "bitboard.hpp"
+#include "memory.hpp"
 
 namespace pvtable {
 
+	// What the stored score says about the real one. Entries loaded from a hash file have no score.
+	enum class Bound { NONE, UPPER, LOWER, EXACT };
+
 	struct Entry {
-		Entry(bitboard::Bitboard position_key, move::Move move) : position_key(position_key), move(move) {}
-		Entry() : position_key(), move() {}
+		Entry(bitboard::Bitboard position_key, move::Move move, int depth, int score, Bound bound, uint8_t generation) :
+			position_key(position_key), move(move), depth(depth), score(score), bound(bound), generation(generation) {}
+		Entry() : position_key(), move(), depth(), score(), bound(Bound::NONE), generation() {}
 
 		move::Move move;
 		bitboard::Bitboard position_key;
+		// remaining depth of the search that stored the move: 0 at the first quiescence ply, negative deeper in it
+		int depth;
+		// mate scores count from this position, not from the root
+		int score;
+		Bound bound;
+		// the search that stored the entry, only compared for equality so it may wrap
+		uint8_t generation;
 	};
 
 	class PVTable {
 	public:
-		PVTable(size_t size) : size(size) {
-			data = std::make_unique<Entry[]>(size);
+		PVTable(size_t size) : generation(0) {
+			resize(size);
 		}
 
-		PVTable() : size(10000) {
-			data = std::make_unique<Entry[]>(size);
+		PVTable() : PVTable(10000) {}
+
+		void resize(size_t new_size) {
+			// the old table goes first, both together may not fit
+			data.reset();
+			size = new_size;
+			data = memory::makeLargeArray<Entry>(size);
+			clear();
 		}
 
+		// in MB, the table holds a whole number of entries
+		size_t getMegabytes() const {
+			return size * sizeof(Entry) / (1024 * 1024);
+		}
+
+		void setMegabytes(size_t megabytes) {
+			resize(std::max<size_t>(megabytes * 1024 * 1024 / sizeof(Entry), 1));
+		}
+
+		// Every thread clears its own slice, which also spreads the pages of a new table over the NUMA nodes
 		void clear() {
-			// maybe a bit slow, but no need for optimization
+			memory::parallelFor(size, [this](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++)
+					new (&data[i]) Entry();
+			});
+		}
 
-			for (int i = 0; i < size; i++) {
-				data[i].move = {};
-				data[i].position_key = {};
-			}
+		// Entries of earlier searches age instead of being cleared, every search after the first of a game starts
+		// with what the ones before it found
+		void newSearch() {
+			generation++;
 		}
 
-		void add(bitboard::Bitboard key, move::Move value) {
+		// An entry is only replaced by one searched at least as deep, unless an earlier search wrote it. The same
+		// position is no exception, and the quiescence search never replaces a main search entry of its position,
+		// whatever its age, so a capture sequence can't push out the move of a deep search.
+		void add(bitboard::Bitboard key, move::Move value, int depth, int score, Bound bound) {
 			size_t index = key % size;
 			assert(0 <= index && index < size);
-			data[index] = Entry(key, value);
+			Entry& slot = data[index];
+
+			if (slot.generation == generation && slot.depth > depth)
+				return;
+
+			if (slot.position_key == key && depth <= 0 && slot.depth > 0)
+				return;
+
+			slot = Entry(key, value, depth, score, bound, generation);
+		}
+
+		// Entries of nodes that failed low may have a bound without a move
+		bool probe(bitboard::Bitboard key, Entry& entry) const {
+			size_t index = key % size;
+			assert(index < size);
+
+			if (data[index].position_key != key || (data[index].move.isNull() && data[index].bound == Bound::NONE))
+				return false;
+
+			entry = data[index];
+			return true;
 		}
 
 		move::Move probe(bitboard::Bitboard key) const {
@@ -74,17 +132,25 @@ namespace pvtable {
 					break;
 			}
 
-			while (state.ply > 0) {
+			// only take back the moves of the line, the caller may be inside a search
+			for (int i = 0; i < count; i++) {
 				state.undo();
 			}
 
 			return count;
 		}
 
+		// Writes every used entry to a hash file, see pvtable.cpp for the format
+		bool save(const std::string& path) const;
+		// Reads a hash file written with the same Zobrist keys. The table is cleared first, unless merge is set,
+		// then an entry of the file takes its slot if the slot is empty or was searched less deep.
+		bool load(const std::string& path, bool merge);
+
 	private:
 
 		size_t size;
-		std::unique_ptr<Entry[]> data;
+		memory::LargeArray<Entry> data;
+		uint8_t generation;
 		
 	};
 
@@ -0,0 +1,175 @@
+#include <cstring>
+
+#include "san.hpp"
+#include "movegen.hpp"
+#include "attack.hpp"
+#include "constants.hpp"
+#include "util.hpp"
+
+namespace san {
+
+	constexpr const char* PIECE_LETTERS = "PNBRQK";
+
+	// 0 pawn to 5 king, for either color
+	static int pieceType(int piece) {
+		return (piece - 1) % 6;
+	}
+
+	static int letterType(char letter) {
+		const char* found = std::strchr(PIECE_LETTERS, letter);
+		return letter && found ? static_cast<int>(found - PIECE_LETTERS) : -1;
+	}
+
+	move::Move parseSan(board::BoardState& state, const std::string& san) {
+		std::string text = san;
+
+		while (!text.empty() && std::strchr("+#!?", text.back()))
+			text.pop_back();
+
+		if (text == "O-O" || text == "0-0" || text == "O-O-O" || text == "0-0-0") {
+			bool king_side = text.size() == 3;
+
+			for (const auto& move : movegen::generateAllMoves(state)) {
+				if (!move.is_castle || (util::_120ToCol(move.to) == asInt(constants::File::G)) != king_side)
+					continue;
+
+				if (!state.step(move))
+					return {};
+
+				state.undo();
+				return move;
+			}
+
+			return {};
+		}
+
+		int piece_type = 0;
+		int promotion_type = 0;
+
+		if (!text.empty() && letterType(text[0]) > 0) {
+			piece_type = letterType(text[0]);
+			text.erase(0, 1);
+		}
+
+		// e8=Q or e8Q
+		if (text.size() >= 3 && letterType(text.back()) > 0 && piece_type == 0) {
+			promotion_type = letterType(text.back());
+			text.pop_back();
+
+			if (text.back() == '=')
+				text.pop_back();
+		}
+
+		if (text.size() < 2)
+			return {};
+
+		char to_file = text[text.size() - 2];
+		char to_rank = text[text.size() - 1];
+
+		if (to_file < 'a' || to_file > 'h' || to_rank < '1' || to_rank > '8')
+			return {};
+
+		int to = util::_120xyToSquare(to_file - 'a', to_rank - '1');
+		int from_file = -1;
+		int from_rank = -1;
+
+		for (char c : text.substr(0, text.size() - 2)) {
+			if (c >= 'a' && c <= 'h')
+				from_file = c - 'a';
+			else if (c >= '1' && c <= '8')
+				from_rank = c - '1';
+			else if (c != 'x' && c != '-' && c != ':')
+				return {};
+		}
+
+		move::Move found;
+
+		for (const auto& move : movegen::generateAllMoves(state)) {
+			if (move.to != to || move.is_castle || pieceType(state.pieces[move.from]) != piece_type)
+				continue;
+
+			if ((move.promoted_piece ? pieceType(move.promoted_piece) : 0) != promotion_type)
+				continue;
+
+			if ((from_file != -1 && util::_120ToCol(move.from) != from_file) || (from_rank != -1 && util::_120ToRow(move.from) != from_rank))
+				continue;
+
+			if (!state.step(move))
+				continue;
+
+			state.undo();
+
+			if (!found.isNull())
+				return {};
+
+			found = move;
+		}
+
+		return found;
+	}
+
+	std::string toSan(board::BoardState& state, const move::Move& move) {
+		std::string san;
+		int piece_type = pieceType(state.pieces[move.from]);
+		bool capture = move.captured || move.en_passant;
+
+		if (move.is_castle) {
+			san = util::_120ToCol(move.to) == asInt(constants::File::G) ? "O-O" : "O-O-O";
+		}
+		else if (piece_type == 0) {
+			if (capture) {
+				san += constants::FILE_CHAR[util::_120ToCol(move.from)];
+				san += 'x';
+			}
+
+			san += util::_120ToString(move.to);
+
+			if (move.promoted_piece) {
+				san += '=';
+				san += PIECE_LETTERS[pieceType(move.promoted_piece)];
+			}
+		}
+		else {
+			// other legal moves of the same piece type to the same square decide the disambiguation
+			bool ambiguous = false;
+			bool same_file = false;
+			bool same_rank = false;
+
+			for (const auto& other : movegen::generateAllMoves(state)) {
+				if (other.to != move.to || other.from == move.from || pieceType(state.pieces[other.from]) != piece_type)
+					continue;
+
+				if (!state.step(other))
+					continue;
+
+				state.undo();
+				ambiguous = true;
+				same_file |= util::_120ToCol(other.from) == util::_120ToCol(move.from);
+				same_rank |= util::_120ToRow(other.from) == util::_120ToRow(move.from);
+			}
+
+			san += PIECE_LETTERS[piece_type];
+
+			if (ambiguous && (!same_file || same_rank))
+				san += constants::FILE_CHAR[util::_120ToCol(move.from)];
+
+			if (ambiguous && same_file)
+				san += constants::RANK_CHAR[util::_120ToRow(move.from)];
+
+			if (capture)
+				san += 'x';
+
+			san += util::_120ToString(move.to);
+		}
+
+		if (!state.step(move))
+			return san;
+
+		if (attack::isInCheck(state))
+			san += movegen::hasLegalMove(state) ? '+' : '#';
+
+		state.undo();
+		return san;
+	}
+
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+
+#include "board.hpp"
+#include "move.hpp"
+
+namespace san {
+
+	// The legal move written in standard algebraic notation, or a null move if there is none or the notation is ambiguous.
+	// Accepts what PGN files contain in practice: check and annotation marks, 0-0 castling, promotions without the =
+	// and superfluous disambiguation.
+	move::Move parseSan(board::BoardState& state, const std::string& san);
+
+	// SAN of a legal move, with the minimal disambiguation and + or # for checks and mates
+	std::string toSan(board::BoardState& state, const move::Move& move);
+
+}
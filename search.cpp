@@ -1,4 +1,7 @@
 #include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <string>
 
 
 #include "search.hpp"
@@ -10,81 +13,348 @@
 #include "attack.hpp"
 #include "movegen.hpp"
 #include "evaluate.hpp"
+#include "tablebase.hpp"
+#include "threadbinding.hpp"
 
 namespace search {
 
-	void Searcher::readInput() {
-		if (util::inputWaiting()) {
-			stopped = true;
-			std::string input;
+	// singular extensions test the table move from this depth on, with a table score at most this much shallower
+	constexpr int SINGULAR_DEPTH = 8;
+	constexpr int SINGULAR_DEPTH_MARGIN = 3;
+	// table entries don't cut nodes from this fifty move counter on
+	constexpr int TABLE_CUTOFF_FIFTY_MOVE = 90;
+	// nodes without a table move from this depth on get one from a shallower search (PV) or are searched one ply less (non-PV)
+	constexpr int IID_DEPTH = 4;
+	// a capture in the quiescence search has to be able to get this close to alpha
+	constexpr int DELTA_MARGIN = 200;
+
+	static bool isQuiet(const move::Move& move) {
+		return !move.captured && !move.en_passant;
+	}
 
-			std::getline(std::cin, input);
+	// False only for quiet moves that can't check the opponent, the rest still has to be played to know. A move
+	// off a line through the king may uncover a check, otherwise the moved piece must reach the king from its square.
+	static bool mayGiveCheck(const board::BoardState& state, const move::Move& move) {
+		int king = state.player == constants::Color::WHITE ? asInt(constants::Piece::bK) : asInt(constants::Piece::wK);
+		int king_square = util::_120To64(state.piece_list[king][0]);
+		int from = util::_120To64(move.from);
+		int to = util::_120To64(move.to);
+		int piece = state.pieces[move.from];
 
-			if (!input.empty()) {
-				if (input == "quit") {
-					quit = true;
-				}
-			}
-			return;
-		}
+		if (constants::LINE_DIRECTION[from][king_square])
+			return true;
+
+		if (constants::IS_KNIGHT[piece])
+			return bitboard::hasBitAt(attack::KNIGHT_ATTACKS[to], king_square);
+
+		if (!constants::IS_NOT_PAWN[piece])
+			return bitboard::hasBitAt(attack::PAWN_ATTACKS[asInt(state.player)][to], king_square);
+
+		int direction = std::abs(constants::LINE_DIRECTION[to][king_square]);
+
+		return (constants::IS_ROOK_QUEEN[piece] && (direction == 1 || direction == 10))
+			|| (constants::IS_BISHOP_QUEEN[piece] && (direction == 9 || direction == 11));
 	}
 
-	constexpr int MAX_DEPTH = 128;
+	static bool isMateScore(int score) {
+		return std::abs(score) > constants::TB_WIN - MAX_DEPTH;
+	}
+
+	// The table keeps mate scores as the distance from the stored position, the search counts them from the root
+	static int scoreToTable(int score, int ply) {
+		return isMateScore(score) ? score + (score > 0 ? ply : -ply) : score;
+	}
+
+	static int scoreFromTable(int score, int ply) {
+		return isMateScore(score) ? score - (score > 0 ? ply : -ply) : score;
+	}
 
 	void Searcher::setupForSearch(board::BoardState& state) {
-		state.search_history = {};
 		state.search_killers = {};
+		history.age();
 
+		// the table keeps what earlier searches learned, it is only cleared for a new game
+		table.newSearch();
 		state.ply = 0;
-		table.clear();
 
-		stopped = false;
+		eval_table.resetCounters();
+
 		nodes = 0;
-		fh = 0;
-		fhf = 0;
+		completed_depth = 0;
+		tb_hits = 0;
+		stats.clear();
+	}
+
+	void Searcher::startSearch(const board::BoardState& state) {
+		// a running search has already been stopped by the caller before it changed the limits
+		if (search_thread.joinable())
+			search_thread.join();
+
+		search_state = state;
+		stopped = false;
+		search_thread = std::thread([this]() {
+			threadbinding::bindThisThread(0);
+			searchPosition(search_state);
+		});
+	}
+
+	void Searcher::stopSearch() {
+		stopped = true;
+		pondering = false;
+
+		if (search_thread.joinable())
+			search_thread.join();
+	}
+
+	void Searcher::waitForSearch() {
+		// nobody is left to send stop or ponderhit
+		infinite = false;
+		pondering = false;
+
+		if (search_thread.joinable())
+			search_thread.join();
+	}
+
+	void Searcher::ponderHit() {
+		// the opponent played the expected move, our clock starts now
+		stop_time = util::getTimeInMs() + time_allocated;
+		pondering = false;
 	}
 
 	void Searcher::checkTimeUp() {
-		if (timeset && util::getTimeInMs() > stop_time)
+		if (timeset && !pondering && util::getTimeInMs() > stop_time)
 			stopped = true;
 
-		readInput();
+		if (node_limit && nodes >= node_limit)
+			stopped = true;
 	}
 
-	void Searcher::searchPosition(board::BoardState& state) {
-		int best_move = {};
-		int best_score = -constants::INFINITE_VAL;
-		int pv_moves = 0;
-		int pv_number = 0;
+	void Searcher::reportBestMove(const move::Move& best_move, const move::Move& ponder_move) {
+		// UCI doesn't allow a bestmove before stop or ponderhit, even when the search finished early
+		while ((pondering || infinite) && !stopped)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+		// without a legal move there is nothing to play, UCI expects a null move then
+		std::cout << "bestmove " << (best_move.isNull() ? "0000" : best_move.toString());
+
+		if (!ponder_move.isNull())
+			std::cout << " ponder " << ponder_move.toString();
+
+		std::cout << std::endl;
+	}
+
+	void Searcher::reportStats() {
+		if (debug) {
+			if constexpr (stats::ENABLED)
+				std::cout << "info string eval cache hits " << eval_table.getHits() << " misses " << eval_table.getMisses() << std::endl;
+
+			stats.print(std::cout);
+		}
+
+		if (stats::ENABLED && !stats_file.empty() && !stats.writeJson(stats_file))
+			std::cout << "info string Could not write statistics to " << stats_file << std::endl;
+	}
+
+	static std::string scoreToString(int score) {
+		if (std::abs(score) > constants::MATE - MAX_DEPTH) {
+			int moves = (constants::MATE - std::abs(score) + 1) / 2;
+			return "mate " + std::to_string(score > 0 ? moves : -moves);
+		}
+
+		return "cp " + std::to_string(score);
+	}
+
+	// Captures come scored by MVV-LVA from the move generator. Quiet moves are ordered killers first,
+	// then the countermove of the previous move, then by their history.
+	void Searcher::scoreMoves(const board::BoardState& state, std::vector<move::Move>& moves, const move::Move& pv_move) {
+		move::Move counter_move = history.counterMove(state);
+
+		for (auto& move : moves) {
+			if (move == pv_move)
+				move.score = 2000000;
+			else if (!isQuiet(move))
+				continue;
+			else if (move == state.search_killers[0][state.ply])
+				move.score = 900000;
+			else if (move == state.search_killers[1][state.ply])
+				move.score = 800000;
+			else if (move == counter_move)
+				move.score = 700000;
+			else
+				move.score = history.quietScore(state, move);
+		}
+	}
+
+	void Searcher::setupRootMoves(board::BoardState& state) {
+		auto moves = movegen::generateAllMoves(state);
+		scoreMoves(state, moves, table.probe(state.position_key));
+
+		std::sort(moves.begin(), moves.end(), move::compareMoves);
+		root_moves.clear();
 
+		for (const auto& move : moves) {
+			if (!search_moves.empty() && std::find(search_moves.begin(), search_moves.end(), move) == search_moves.end())
+				continue;
+
+			if (!state.step(move))
+				continue;
+
+			state.undo();
+			root_moves.emplace_back(move);
+		}
+	}
+
+	// Searches root_moves[first..], the first with a full window and the rest with a null window around alpha.
+	// Moves that don't raise alpha keep a score of -INFINITE_VAL, so sorting afterwards puts the best one at first
+	// and leaves the order of the others alone.
+	void Searcher::searchRoot(board::BoardState& state, int depth, size_t first) {
+		int alpha = -constants::INFINITE_VAL;
+		int beta = constants::INFINITE_VAL;
+
+		nodes++;
+		stats.node(stats::PV_NODE, depth);
+
+		if (attack::isInCheck(state))
+			depth++;
+
+		root_depth = depth;
+
+		for (size_t i = first; i < root_moves.size(); i++) {
+			RootMove& root_move = root_moves[i];
+
+			if (print_info && util::getTimeInMs() - start_time > 1000) {
+				std::cout << "info depth " << depth << " currmove " << root_move.move.toString() << " currmovenumber " << i + 1 << std::endl;
+			}
+
+			long nodes_before = nodes;
+
+			state.step(root_move.move);
+			int score;
+
+			if (i == first) {
+				score = -alphaBeta(state, -beta, -alpha, depth - 1, true);
+			}
+			else {
+				score = -alphaBeta(state, -alpha - 1, -alpha, depth - 1, true);
+
+				if (score > alpha && !stopped)
+					score = -alphaBeta(state, -beta, -alpha, depth - 1, true);
+			}
+
+			if (!stopped && score > alpha) {
+				alpha = score;
+				root_move.score = score;
+
+				table.getLine(state, depth - 1);
+				root_move.pv = { root_move.move };
+				root_move.pv.insert(root_move.pv.end(), state.pv_array.begin(), state.pv_array.end());
+			}
+
+			state.undo();
+			root_move.nodes += nodes - nodes_before;
+
+			if (stopped)
+				return;
+		}
+	}
+
+	void Searcher::think(board::BoardState& state) {
 		setupForSearch(state);
 
-		for (int current_depth = 1; current_depth <= depth; current_depth++) {
-			best_score = alphaBeta(state, -constants::INFINITE_VAL, constants::INFINITE_VAL, current_depth, true);
+		// with the root in the tablebases, play the move that keeps the best result and makes progress by DTZ
+		if (!state.castle_permissions && tablebase::pieceCount(state) <= tablebase::maxPieces()) {
+			move::Move tb_move;
+			int tb_score;
+
+			if (tablebase::probeRoot(state, tb_move, tb_score)) {
+				root_moves = { RootMove(tb_move) };
+				root_moves[0].score = tb_score;
+
+				if (print_info) {
+					std::cout << "info depth 1 score " << scoreToString(tb_score) << " nodes 0 time " << util::getTimeInMs() - start_time
+						<< " tbhits 1 pv " << tb_move.toString() << std::endl;
+				}
 
-			pv_moves = table.getLine(state, current_depth);
+				return;
+			}
+		}
 
-			std::cout << "info score cp " << best_score << " depth " << current_depth << " nodes " << nodes
-				<< " time " << util::getTimeInMs() - start_time << std::endl;
+		setupRootMoves(state);
+		size_t line_count = std::min(static_cast<size_t>(multi_pv), root_moves.size());
 
-			std::cout << "Principle Variation: " << std::endl;
+		auto by_score = [](const RootMove& a, const RootMove& b) { return a.score > b.score; };
+		auto by_nodes = [](const RootMove& a, const RootMove& b) { return a.previous_nodes > b.previous_nodes; };
 
-			for (const auto& move : state.pv_array) {
-				std::cout << move.toString() << ", ";
+		for (int current_depth = 1; current_depth <= depth && !root_moves.empty(); current_depth++) {
+			for (auto& root_move : root_moves) {
+				root_move.previous_score = root_move.score;
+				root_move.score = -constants::INFINITE_VAL;
+				root_move.previous_nodes = root_move.nodes;
+				root_move.nodes = 0;
 			}
-			std::cout << std::endl;
 
-			std::cout << "Ordering: " << fhf / fh << std::endl;
+			// Lines of the last iteration go first, in their order. The remaining moves are ordered by the size of
+			// their last subtree, since a move that took many nodes to refute is the most likely to become best.
+			if (current_depth > 1)
+				std::stable_sort(root_moves.begin() + line_count, root_moves.end(), by_nodes);
+
+			// MultiPV: each line searches the moves the better lines didn't take
+			for (size_t line = 0; line < line_count; line++) {
+				searchRoot(state, current_depth, line);
+				std::stable_sort(root_moves.begin() + line, root_moves.end(), by_score);
+
+				if (stopped)
+					break;
+			}
 
 			if (stopped)
 				break;
+
+			table.add(state.position_key, root_moves[0].move, current_depth, root_moves[0].score, pvtable::Bound::EXACT);
+			completed_depth = current_depth;
+
+			for (size_t i = 0; i < line_count && print_info; i++) {
+				const RootMove& root_move = root_moves[i];
+
+				std::cout << "info depth " << current_depth << " multipv " << i + 1 << " score " << scoreToString(root_move.score)
+					<< " nodes " << nodes << " time " << util::getTimeInMs() - start_time << " tbhits " << tb_hits << " pv";
+
+				for (const auto& move : root_move.pv)
+					std::cout << " " << move.toString();
+
+				std::cout << std::endl;
+			}
+		}
+
+		if (print_info)
+			reportStats();
+	}
+
+	void Searcher::searchPosition(board::BoardState& state) {
+		think(state);
+
+		if (root_moves.empty()) {
+			reportBestMove({}, {});
+			return;
 		}
 
-		std::cout << "bestmove " << state.pv_array[0].toString() << std::endl;
+		const auto& best_line = root_moves[0].pv;
+		reportBestMove(best_line[0], best_line.size() > 1 ? best_line[1] : move::Move());
+	}
+
+	int Searcher::evaluate(const board::BoardState& state) {
+		int score;
+
+		if (eval_table.probe(state.position_key, score))
+			return score;
 
+		score = evaluate::evaluatePosition(state);
+		eval_table.add(state.position_key, score);
+
+		return score;
 	}
 
-	int Searcher::quiesence(board::BoardState& state, int alpha, int beta) {
+	int Searcher::quiesence(board::BoardState& state, int alpha, int beta, int depth) {
 		assert(state.checkBoard());
 
 		if (nodes % 2047 == 0)
@@ -92,48 +362,100 @@ namespace search {
 
 
 		nodes++;
+		stats.node(stats::QSEARCH_NODE, 0);
 
 		if ((state.isRepetition() || state.fifty_move >= 100) && state.ply) {
 			return 0;
 		}
 
-		if(state.ply > MAX_DEPTH - 1) {
-			return evaluate::evaluatePosition(state);
+		bool is_in_check = attack::isInCheck(state);
+
+		if (state.ply > MAX_DEPTH - 1) {
+			return is_in_check ? 0 : evaluate(state);
 		}
 
-		int score = evaluate::evaluatePosition(state);
+		int original_alpha = alpha;
+		pvtable::Entry entry;
+		bool table_hit = table.probe(state.position_key, entry);
+		move::Move pv_move = table_hit ? entry.move : move::Move();
+		stats.ttProbe(stats::QSEARCH_NODE, 0, table_hit);
 
-		if (score >= beta)
-			return beta;
+		// every entry is at least as deep as the quiescence search, so any bound that decides the window is used
+		if (table_hit && entry.depth >= depth) {
+			int score = scoreFromTable(entry.score, state.ply);
 
-		if (score > alpha)
-			alpha = score;
+			if (entry.bound == pvtable::Bound::EXACT)
+				return std::clamp(score, alpha, beta);
+			if (entry.bound == pvtable::Bound::LOWER && score >= beta)
+				return beta;
+			if (entry.bound == pvtable::Bound::UPPER && score <= alpha)
+				return alpha;
+		}
 
-		auto moves = movegen::generateAllCaptures(state);
-		int legal_moves = 0;
-		int prev_alpha = alpha;
-		move::Move pv_move;
-		move::Move best_move = {};
+		int stand_pat = is_in_check ? -constants::INFINITE_VAL : evaluate(state);
+
+		if (!is_in_check)
+			stats.evalCall(stats::QSEARCH_NODE, 0);
 
-		pv_move = table.probe(state.position_key);
+		// in check every evasion is searched and standing pat isn't allowed
+		std::vector<move::Move> moves;
+
+		if (is_in_check) {
+			moves = movegen::generateAllMoves(state);
+			scoreMoves(state, moves, pv_move);
+		}
+		else {
+			if (stand_pat >= beta)
+				return beta;
+
+			if (stand_pat > alpha)
+				alpha = stand_pat;
+
+			moves = movegen::generateAllCaptures(state);
+
+			// the first ply also tries quiet checks, they are told apart from the rest after the move is played
+			if (depth == 0 && qsearch_checks) {
+				for (const auto& move : movegen::generateAllMoves(state)) {
+					if (isQuiet(move) && !move.promoted_piece && !move.is_castle && mayGiveCheck(state, move))
+						moves.push_back(move);
+				}
+			}
 
-		if (!pv_move.isNull()) {
 			for (auto& move : moves) {
-				if (move == pv_move) {
+				if (move == pv_move)
 					move.score = 2000000;
-					break;
-				}
 			}
 		}
 
+		stats.movegenCall(stats::QSEARCH_NODE, 0);
+
+		int legal_moves = 0;
+		move::Move best_move = {};
+
 		std::sort(moves.begin(), moves.end(), move::compareMoves);
 
 		for (const auto& move : moves) {
+			bool quiet = isQuiet(move) && !move.promoted_piece;
+
+			// Delta pruning: a capture that can't lift the position back to alpha even with a margin is skipped.
+			// Promotions keep the value of the new piece.
+			if (!is_in_check && !quiet) {
+				int gain = constants::PIECE_VALUE[move.en_passant ? asInt(constants::Piece::wP) : move.captured] + constants::PIECE_VALUE[move.promoted_piece];
+
+				if (stand_pat + gain + DELTA_MARGIN <= alpha)
+					continue;
+			}
+
 			if (!state.step(move))
 				continue;
 
+			if (!is_in_check && quiet && !attack::isInCheck(state)) {
+				state.undo();
+				continue;
+			}
+
 			legal_moves++;
-			int score = -quiesence(state, -beta, -alpha);
+			int score = -quiesence(state, -beta, -alpha, depth - 1);
 			state.undo();
 
 
@@ -143,10 +465,8 @@ namespace search {
 
 			if (score > alpha) {
 				if (score >= beta) {
-					if (legal_moves == 1) {
-						fhf++;
-					}
-					fh++;
+					stats.betaCutoff(stats::QSEARCH_NODE, 0, legal_moves - 1, move == pv_move);
+					table.add(state.position_key, move, depth, scoreToTable(beta, state.ply), pvtable::Bound::LOWER);
 					return beta;
 				}
 
@@ -156,23 +476,30 @@ namespace search {
 
 
 		}
-		if (alpha != prev_alpha) {
-			table.add(state.position_key, best_move);
-		}
+
+		if (is_in_check && legal_moves == 0)
+			return -constants::MATE + state.ply;
+
+		// standing pat above alpha is an exact score as well, only a node that never got above alpha is a bound
+		pvtable::Bound bound = alpha > original_alpha ? pvtable::Bound::EXACT : pvtable::Bound::UPPER;
+		table.add(state.position_key, best_move.isNull() ? pv_move : best_move, depth, scoreToTable(alpha, state.ply), bound);
 
 		return alpha;
 	}
 
-	int Searcher::alphaBeta(board::BoardState& state, int alpha, int beta, int depth, bool null) {
+	int Searcher::alphaBeta(board::BoardState& state, int alpha, int beta, int depth, bool null, const move::Move& excluded) {
 		assert(state.checkBoard());
 		
 
-		nodes++;
-
-		if (depth == 0) {
+		// the quiescence search counts the node itself
+		if (depth <= 0) {
 			return quiesence(state, alpha, beta);
 		}
 
+		nodes++;
+		stats::NodeType node_type = beta - alpha > 1 ? stats::PV_NODE : stats::NON_PV_NODE;
+		stats.node(node_type, depth);
+
 		if (nodes % 2047 == 0)
 			checkTimeUp();
 
@@ -181,17 +508,81 @@ namespace search {
 			return 0;
 		}
 
-		if (state.ply > MAX_DEPTH - 1) {
-			return evaluate::evaluatePosition(state);
+		// a move of the side to move reaches a position of the search again, so it can have at least a draw
+		if (state.ply && alpha < 0 && state.hasUpcomingRepetition()) {
+			alpha = 0;
+
+			if (alpha >= beta)
+				return alpha;
 		}
 
-		int king = state.player == constants::Color::WHITE ? asInt(constants::Piece::wK) : asInt(constants::Piece::bK);
-		bool is_in_check = attack::isSquareAttacked(state.piece_list[king][0], static_cast<constants::Color>(asInt(state.player) ^ 1), state);
+		// Mate distance pruning: no line from here can mate faster than in one move or be mated sooner than now,
+		// so once a shorter mate is known the window shrinks and may close
+		if (state.ply) {
+			alpha = std::max(alpha, -constants::MATE + state.ply);
+			beta = std::min(beta, constants::MATE - state.ply - 1);
 
-		if (is_in_check) {
+			if (alpha >= beta)
+				return alpha;
+		}
+
+		// The WDL tables assume a fresh fifty move counter, so they are probed right after captures and pawn moves.
+		// Cursed wins and blessed losses are draws under the fifty move rule.
+		if (state.ply && state.fifty_move == 0 && !state.castle_permissions && excluded.isNull()) {
+			int piece_count = tablebase::pieceCount(state);
+			int max_pieces = tablebase::maxPieces();
+
+			if (piece_count < max_pieces || (piece_count == max_pieces && depth >= tb_probe_depth)) {
+				tablebase::ProbeState result;
+				tablebase::WDLScore wdl = tablebase::probeWDL(state, result);
+
+				if (result != tablebase::ProbeState::FAIL) {
+					tb_hits++;
+
+					if (wdl == tablebase::WDL_WIN)
+						return constants::TB_WIN - state.ply;
+					else if (wdl == tablebase::WDL_LOSS)
+						return -constants::TB_WIN + state.ply;
+
+					return 0;
+				}
+			}
+		}
+
+		bool is_in_check = attack::isInCheck(state);
+		bool check_extended = is_in_check && state.ply < 2 * root_depth;
+
+		// Checks are extended while the line is at most twice as long as the iteration depth, so perpetual
+		// checking sequences can't blow up the tree
+		if (check_extended) {
 			depth++;
 		}
 
+		// The hard ply cap: no line goes deeper than MAX_DEPTH, whatever was extended on the way
+		depth = std::min(depth, MAX_DEPTH - 1 - state.ply);
+
+		if (depth <= 0) {
+			return quiesence(state, alpha, beta);
+		}
+
+		pvtable::Entry entry;
+		bool table_hit = table.probe(state.position_key, entry);
+		move::Move pv_move = table_hit ? entry.move : move::Move();
+		stats.ttProbe(node_type, depth, table_hit);
+
+		// An entry searched at least as deep decides the node when its bound does. Close to the fifty move rule
+		// the node is searched anyway, the entry may come from a path with a fresh counter.
+		if (state.ply && excluded.isNull() && table_hit && entry.depth >= depth && state.fifty_move < TABLE_CUTOFF_FIFTY_MOVE) {
+			int score = scoreFromTable(entry.score, state.ply);
+
+			if (entry.bound == pvtable::Bound::EXACT)
+				return std::clamp(score, alpha, beta);
+			if (entry.bound == pvtable::Bound::LOWER && score >= beta)
+				return beta;
+			if (entry.bound == pvtable::Bound::UPPER && score <= alpha)
+				return alpha;
+		}
+
 		// fix this
 		/*
 		if (null && !is_in_check && state.ply && (state.knights_bishops_count[asInt(state.player)] + state.rooks_queens_count[asInt(state.player)]) > 0 && depth >= 4) {
@@ -211,32 +602,81 @@ namespace search {
 		
 
 		auto moves = movegen::generateAllMoves(state);
+		stats.movegenCall(node_type, depth);
 
 		int legal_moves = 0;
 		int prev_alpha = alpha;
-		move::Move pv_move;
 		move::Move best_move = {};
+		std::vector<move::Move> quiets;
+		// quiets searched up to and including best_move
+		size_t best_quiet_count = 0;
+
+		// Internal iterative deepening: a PV node is worth a shallower search to find its first move. A non-PV
+		// node without a table move was most likely never searched and is reduced instead (internal iterative reduction).
+		// The shallower search extends the check itself, so it starts from the depth before the extension.
+		if (pv_move.isNull() && depth >= IID_DEPTH && excluded.isNull()) {
+			if (node_type == stats::PV_NODE) {
+				alphaBeta(state, alpha, beta, depth - 2 - check_extended, true);
+
+				if (stopped)
+					return 0;
+
+				table_hit = table.probe(state.position_key, entry);
+				pv_move = table_hit ? entry.move : move::Move();
+			}
+			else {
+				depth--;
+			}
+		}
 
-		pv_move = table.probe(state.position_key);
+		// Singular extension: the table move is extended when a reduced search of every other move fails low
+		// against a margin below its table score. If even the others beat beta the node is cut (multi-cut).
+		int singular_extension = 0;
 
-		if (!pv_move.isNull()) {
-			for (auto& move : moves) {
-				if (move == pv_move) {
-					move.score = 2000000;
-					break;
-				}
-			}
+		if (state.ply && depth >= SINGULAR_DEPTH && excluded.isNull() && !pv_move.isNull() && entry.depth >= depth - SINGULAR_DEPTH_MARGIN
+			&& (entry.bound == pvtable::Bound::LOWER || entry.bound == pvtable::Bound::EXACT) && !isMateScore(entry.score)) {
+			int singular_beta = scoreFromTable(entry.score, state.ply) - 2 * depth;
+			int score = alphaBeta(state, singular_beta - 1, singular_beta, (depth - 1) / 2, false, pv_move);
+
+			if (stopped)
+				return 0;
+
+			if (score < singular_beta)
+				singular_extension = 1;
+			else if (singular_beta >= beta)
+				return beta;
 		}
-		
 
+		scoreMoves(state, moves, pv_move);
 		std::sort(moves.begin(), moves.end(), move::compareMoves);
 
 		for (const auto& move : moves) {
+			if (move == excluded)
+				continue;
+
 			if (!state.step(move))
 				continue;
 
 			legal_moves++;
-			int score = -alphaBeta(state, -beta, -alpha, depth - 1, true);
+
+			if (isQuiet(move))
+				quiets.push_back(move);
+
+			int extension = move == pv_move ? singular_extension : 0;
+			int score;
+
+			// Principal variation search: after the first move the others only have to be proven worse than alpha,
+			// which a null window does cheaply. One that isn't is searched again with the full window.
+			if (legal_moves == 1) {
+				score = -alphaBeta(state, -beta, -alpha, depth - 1 + extension, true);
+			}
+			else {
+				score = -alphaBeta(state, -alpha - 1, -alpha, depth - 1 + extension, true);
+
+				if (score > alpha && score < beta && !stopped)
+					score = -alphaBeta(state, -beta, -alpha, depth - 1 + extension, true);
+			}
+
 			state.undo();
 
 			if (stopped == true)
@@ -245,34 +685,38 @@ namespace search {
 
 			if (score > alpha) {
 				if (score >= beta) {
-					if (legal_moves == 1) {
-						fhf++;
-					}
-					fh++;
+					stats.betaCutoff(node_type, depth, legal_moves - 1, move == pv_move);
 					
-					if (!move.captured) {
-						state.search_killers[1][state.ply] = state.search_killers[0][state.ply];
-						state.search_killers[0][state.ply] = move;
+					if (isQuiet(move)) {
+						if (!(state.search_killers[0][state.ply] == move)) {
+							state.search_killers[1][state.ply] = state.search_killers[0][state.ply];
+							state.search_killers[0][state.ply] = move;
+						}
+
+						history.updateQuiets(state, move, quiets, depth);
 					}
+
+					// an exclusion search shares the key of the node, its results must not replace the table move
+					if (excluded.isNull())
+						table.add(state.position_key, move, depth, scoreToTable(beta, state.ply), pvtable::Bound::LOWER);
 					
 					return beta;
 				}
 
 				alpha = score;
 				best_move = move;
-
-				if (!move.captured) {
-					state.search_history[state.pieces[move.from]][move.to] += depth;
-				}
+				best_quiet_count = quiets.size();
 			}
 
 			
 		}
 
 		if (legal_moves == 0) {
-			int king = state.player == constants::Color::WHITE ? asInt(constants::Piece::wK) : asInt(constants::Piece::bK);
+			// the excluded move was the only legal one, which makes it singular
+			if (!excluded.isNull())
+				return alpha;
 
-			if (attack::isSquareAttacked(state.piece_list[king][0], static_cast<constants::Color>(asInt(state.player) ^ 1), state)) {
+			if (is_in_check) {
 				return -constants::MATE + state.ply;
 			}
 			else {
@@ -280,8 +724,19 @@ namespace search {
 			}
 		}
 
-		if (alpha != prev_alpha)
-			table.add(state.position_key, best_move);
+		// a node that failed low keeps the table move it was ordered by
+		if (alpha == prev_alpha && excluded.isNull())
+			table.add(state.position_key, pv_move, depth, scoreToTable(alpha, state.ply), pvtable::Bound::UPPER);
+
+		if (alpha != prev_alpha && excluded.isNull()) {
+			table.add(state.position_key, best_move, depth, scoreToTable(alpha, state.ply), pvtable::Bound::EXACT);
+
+			// the quiets searched after the best move were never compared with it
+			if (isQuiet(best_move)) {
+				quiets.resize(best_quiet_count);
+				history.updateQuiets(state, best_move, quiets, depth);
+			}
+		}
 
 		return alpha;
 
@@ -1,38 +1,126 @@
 #pragma once
 
+#include <atomic>
+#include <thread>
+
 #include "board.hpp"
 #include "pvtable.hpp"
+#include "evaltable.hpp"
+#include "book.hpp"
+#include "history.hpp"
+#include "stats.hpp"
 
 namespace search {
 
+	constexpr int MAX_DEPTH = 128;
+
+	// A legal move of the root position. It lives for the whole search, so the score, PV and
+	// subtree size of one iteration are there to order the next one.
+	struct RootMove {
+		RootMove(const move::Move& move) : move(move), score(-constants::INFINITE_VAL), previous_score(-constants::INFINITE_VAL),
+			pv({ move }), nodes(0), previous_nodes(0) {}
+
+		// A stopped iteration leaves the best move with the score of the one before, -INFINITE_VAL if it has none
+		int lastScore() const {
+			return score != -constants::INFINITE_VAL ? score : previous_score;
+		}
+
+		move::Move move;
+		int score;
+		int previous_score;
+		std::vector<move::Move> pv;
+		long nodes;
+		long previous_nodes;
+	};
+
 	class Searcher {
 	public:
-		Searcher(size_t table_size, int depth) : depth(depth), table(table_size), quit(false){
+		Searcher(size_t table_size, size_t eval_table_size, int depth) : depth(depth), table(table_size), eval_table(eval_table_size),
+			infinite(false), pondering(false), stopped(false), debug(false), node_limit(0), print_info(true), qsearch_checks(false), hash_learning(false),
+			own_book(false), book_depth(20), book_random(true), tb_probe_depth(1), tb_hits(0), multi_pv(1) {
 		};
 
+		~Searcher() {
+			stopSearch();
+		}
+
+		// The search runs on its own thread on a copy of the position, so the input thread stays free for stop and ponderhit
+		void startSearch(const board::BoardState& state);
+		void stopSearch();
+		void waitForSearch();
+		void ponderHit();
+
 		void checkTimeUp();
 		void setupForSearch(board::BoardState& state);
+		void reportBestMove(const move::Move& best_move, const move::Move& ponder_move);
+		void reportStats();
 
-		int quiesence(board::BoardState& state, int alpha, int beta);
-		int alphaBeta(board::BoardState& state, int alpha, int beta, int depth, bool null);
+		int evaluate(const board::BoardState& state);
+		// depth is 0 at the first ply of the quiescence search and counts down from there
+		int quiesence(board::BoardState& state, int alpha, int beta, int depth = 0);
+		// excluded is skipped in the search of the node, for the singular extension test of that move
+		int alphaBeta(board::BoardState& state, int alpha, int beta, int depth, bool null, const move::Move& excluded = move::Move());
+		void scoreMoves(const board::BoardState& state, std::vector<move::Move>& moves, const move::Move& pv_move);
+		void setupRootMoves(board::BoardState& state);
+		void searchRoot(board::BoardState& state, int depth, size_t first);
+		// Iterative deepening without answering bestmove. Afterwards root_moves[0] holds the best move, its score and PV.
+		void think(board::BoardState& state);
 		void searchPosition(board::BoardState& state);
-		void readInput();
 
 		pvtable::PVTable table;
+		// one per searcher like the table: the engine searches on one thread, batch and gensfen workers own their searchers
+		evaltable::EvalTable eval_table;
+		history::History history;
+
+		board::BoardState search_state;
+		std::thread search_thread;
+
+		// written by the input thread while searching
+		std::atomic<bool> infinite;
+		std::atomic<bool> pondering;
+		std::atomic<bool> stopped;
+		std::atomic<long> stop_time;
+		std::atomic<bool> debug;
 
-		bool infinite;
-		bool quit;
-		bool stopped;
 		long start_time;
-		long stop_time;
+		long time_allocated;
 		int depth;
+		// depth of the iteration in progress, check extensions stop at twice this ply
+		int root_depth;
 		int depthset;
 		int timeset;
 		int remaining_moves;
 		long nodes;
+		// depth of the last finished iteration
+		int completed_depth;
+		// stops the search after this many nodes when not 0
+		long node_limit;
+		// info lines, off for searches that aren't talking to a GUI
+		bool print_info;
+		// quiet checks at the first ply of the quiescence search
+		bool qsearch_checks;
+
+		// dumped at the end of every search with debug on, and written to stats_file when it is set
+		stats::SearchStats stats;
+		std::string stats_file;
+
+		// SaveHash and LoadHash use hash_file, hash_learning merges a loaded file into the table instead of replacing it
+		std::string hash_file;
+		bool hash_learning;
+
+		book::Book book;
+		bool own_book;
+		int book_depth;
+		bool book_random;
+
+		// tablebases are probed at full depth only for positions with the largest available piece count
+		int tb_probe_depth;
+		long tb_hits;
 
-		float fh;
-		float fhf;
+		int multi_pv;
+		std::vector<RootMove> root_moves;
+		// restricts the root moves when not empty (go searchmoves)
+		std::vector<move::Move> search_moves;
 	};
 
 
@@ -0,0 +1,140 @@
+#include <fstream>
+#include <iomanip>
+
+#include "stats.hpp"
+
+namespace stats {
+
+	static const char* NODE_TYPE_NAMES[NODE_TYPE_COUNT] = { "pv", "non_pv", "qsearch" };
+
+	void Counters::add(const Counters& other) {
+		nodes += other.nodes;
+		tt_probes += other.tt_probes;
+		tt_hits += other.tt_hits;
+		tt_move_cutoffs += other.tt_move_cutoffs;
+		beta_cutoffs += other.beta_cutoffs;
+		eval_calls += other.eval_calls;
+		movegen_calls += other.movegen_calls;
+
+		for (int i = 0; i < CUTOFF_INDEX_COUNT; i++)
+			cutoff_index[i] += other.cutoff_index[i];
+	}
+
+	Counters SearchStats::total(NodeType type) const {
+		Counters sum;
+
+		for (const auto& c : counters[type])
+			sum.add(c);
+
+		return sum;
+	}
+
+	static double percent(uint64_t part, uint64_t whole) {
+		return whole ? 100.0 * part / whole : 0.0;
+	}
+
+	static void printCounters(std::ostream& out, const Counters& c) {
+		out << " nodes " << c.nodes
+			<< " tthits " << c.tt_hits << "/" << c.tt_probes << " (" << percent(c.tt_hits, c.tt_probes) << "%)"
+			<< " cutoffs " << c.beta_cutoffs << " first " << percent(c.cutoff_index[0], c.beta_cutoffs) << "%"
+			<< " ttmove " << percent(c.tt_move_cutoffs, c.beta_cutoffs) << "%"
+			<< " evals " << c.eval_calls << " movegens " << c.movegen_calls;
+	}
+
+	void SearchStats::print(std::ostream& out) const {
+		if constexpr (!ENABLED) {
+			out << "info string search statistics need a build with SEARCH_STATS defined" << std::endl;
+			return;
+		}
+
+		Counters all;
+
+		for (int type = 0; type < NODE_TYPE_COUNT; type++)
+			all.add(total(static_cast<NodeType>(type)));
+
+		uint64_t qsearch_nodes = total(QSEARCH_NODE).nodes;
+
+		out << std::fixed << std::setprecision(1);
+		out << "info string stats total";
+		printCounters(out, all);
+		out << " qsearch " << percent(qsearch_nodes, all.nodes) << "%" << std::endl;
+
+		for (int type = 0; type < NODE_TYPE_COUNT; type++) {
+			for (int depth = 0; depth < DEPTH_COUNT; depth++) {
+				const Counters& c = counters[type][depth];
+
+				if (!c.nodes)
+					continue;
+
+				out << "info string stats " << NODE_TYPE_NAMES[type] << " depth " << depth;
+				printCounters(out, c);
+				out << std::endl;
+			}
+		}
+
+		out << "info string stats cutoff index";
+
+		for (int i = 0; i < CUTOFF_INDEX_COUNT; i++)
+			out << " " << i + 1 << (i == CUTOFF_INDEX_COUNT - 1 ? "+" : "") << ":" << all.cutoff_index[i];
+
+		out << std::endl;
+		out << std::defaultfloat;
+	}
+
+	static void writeCountersJson(std::ostream& out, const Counters& c) {
+		out << "\"nodes\": " << c.nodes
+			<< ", \"tt_probes\": " << c.tt_probes
+			<< ", \"tt_hits\": " << c.tt_hits
+			<< ", \"tt_move_cutoffs\": " << c.tt_move_cutoffs
+			<< ", \"beta_cutoffs\": " << c.beta_cutoffs
+			<< ", \"eval_calls\": " << c.eval_calls
+			<< ", \"movegen_calls\": " << c.movegen_calls
+			<< ", \"cutoff_index\": [";
+
+		for (int i = 0; i < CUTOFF_INDEX_COUNT; i++)
+			out << (i ? ", " : "") << c.cutoff_index[i];
+
+		out << "]";
+	}
+
+	bool SearchStats::writeJson(const std::string& path) const {
+		if constexpr (!ENABLED)
+			return false;
+
+		std::ofstream out(path);
+
+		if (!out)
+			return false;
+
+		out << "{\n";
+
+		for (int type = 0; type < NODE_TYPE_COUNT; type++) {
+			Counters sum = total(static_cast<NodeType>(type));
+
+			out << "  \"" << NODE_TYPE_NAMES[type] << "\": {\n    \"total\": {";
+			writeCountersJson(out, sum);
+			out << "},\n    \"depths\": [";
+
+			bool first = true;
+
+			for (int depth = 0; depth < DEPTH_COUNT; depth++) {
+				const Counters& c = counters[type][depth];
+
+				if (!c.nodes)
+					continue;
+
+				out << (first ? "\n" : ",\n") << "      {\"depth\": " << depth << ", ";
+				writeCountersJson(out, c);
+				out << "}";
+				first = false;
+			}
+
+			out << "\n    ]\n  }" << (type == NODE_TYPE_COUNT - 1 ? "\n" : ",\n");
+		}
+
+		out << "}\n";
+
+		return static_cast<bool>(out);
+	}
+
+}
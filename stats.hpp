@@ -0,0 +1,97 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <ostream>
+#include <algorithm>
+#include <cinttypes>
+
+namespace stats {
+
+	// Statistics are only counted in builds with SEARCH_STATS defined. Otherwise every recording
+	// function is empty and the calls in the search compile away.
+#ifdef SEARCH_STATS
+	constexpr bool ENABLED = true;
+#else
+	constexpr bool ENABLED = false;
+#endif
+
+	enum NodeType { PV_NODE, NON_PV_NODE, QSEARCH_NODE, NODE_TYPE_COUNT };
+
+	// Nodes deeper than this are counted with the last depth
+	constexpr int DEPTH_COUNT = 64;
+	// Cutoffs by the 16th move or later share the last bucket
+	constexpr int CUTOFF_INDEX_COUNT = 16;
+
+	struct Counters {
+		uint64_t nodes = 0;
+		uint64_t tt_probes = 0;
+		uint64_t tt_hits = 0;
+		uint64_t tt_move_cutoffs = 0;
+		uint64_t beta_cutoffs = 0;
+		uint64_t eval_calls = 0;
+		uint64_t movegen_calls = 0;
+		std::array<uint64_t, CUTOFF_INDEX_COUNT> cutoff_index = {};
+
+		void add(const Counters& other);
+	};
+
+	// Counters of one search, by node type and remaining depth. Quiescence nodes are all counted at depth 0.
+	// Only the search thread writes them, the dump runs on the same thread once the search is over.
+	class SearchStats {
+	public:
+		void clear() {
+			if constexpr (ENABLED)
+				counters = {};
+		}
+
+		void node(NodeType type, int depth) {
+			if constexpr (ENABLED)
+				at(type, depth).nodes++;
+		}
+
+		void ttProbe(NodeType type, int depth, bool hit) {
+			if constexpr (ENABLED) {
+				Counters& c = at(type, depth);
+				c.tt_probes++;
+				c.tt_hits += hit;
+			}
+		}
+
+		void evalCall(NodeType type, int depth) {
+			if constexpr (ENABLED)
+				at(type, depth).eval_calls++;
+		}
+
+		void movegenCall(NodeType type, int depth) {
+			if constexpr (ENABLED)
+				at(type, depth).movegen_calls++;
+		}
+
+		// move_index counts the legal moves searched before the cutoff, starting at 0
+		void betaCutoff(NodeType type, int depth, int move_index, bool tt_move) {
+			if constexpr (ENABLED) {
+				Counters& c = at(type, depth);
+				c.beta_cutoffs++;
+				c.tt_move_cutoffs += tt_move;
+				c.cutoff_index[std::min(move_index, CUTOFF_INDEX_COUNT - 1)]++;
+			}
+		}
+
+		// Readable summary as UCI info strings, one line per node type and depth
+		void print(std::ostream& out) const;
+		// The same counters as a JSON object
+		bool writeJson(const std::string& path) const;
+
+	private:
+		Counters& at(NodeType type, int depth) {
+			return counters[type][std::clamp(depth, 0, DEPTH_COUNT - 1)];
+		}
+
+		Counters total(NodeType type) const;
+
+		// without SEARCH_STATS nothing is ever recorded, so the table takes no room
+		std::array<std::array<Counters, DEPTH_COUNT>, ENABLED ? NODE_TYPE_COUNT : 0> counters;
+	};
+
+}
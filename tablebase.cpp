@@ -0,0 +1,1074 @@
+#include <array>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <unordered_map>
+#include <filesystem>
+#include <iostream>
+
+#include "tablebase.hpp"
+#include "mappedfile.hpp"
+#include "constants.hpp"
+#include "movegen.hpp"
+#include "attack.hpp"
+#include "util.hpp"
+
+// Probing code for Syzygy tablebases. The file layout and the index encoding follow the
+// reference implementation by Ronald de Man, squares are numbered a1 = 0 ... h8 = 63 and
+// pieces use the codes of the generator: white pawn..king = 1..6, black pawn..king = 9..14.
+
+namespace tablebase {
+
+	constexpr int MAX_PIECES = 7;
+	constexpr int MAX_DTZ = 1 << 18;
+
+	constexpr std::array<uint8_t, 4> WDL_MAGIC = { 0x71, 0xE8, 0x23, 0x5D };
+	constexpr std::array<uint8_t, 4> DTZ_MAGIC = { 0xD7, 0x66, 0x0C, 0xA5 };
+
+	enum TableFlag {
+		FLAG_STM = 1,
+		FLAG_MAPPED = 2,
+		FLAG_WIN_PLIES = 4,
+		FLAG_LOSS_PLIES = 8,
+		FLAG_WIDE = 16,
+		FLAG_SINGLE_VALUE = 128
+	};
+
+	static uint32_t readLittleEndian32(const uint8_t* bytes) {
+		return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+	}
+
+	static uint16_t readLittleEndian16(const uint8_t* bytes) {
+		return static_cast<uint16_t>(bytes[0] | (bytes[1] << 8));
+	}
+
+	static uint32_t readBigEndian32(const uint8_t* bytes) {
+		return (static_cast<uint32_t>(bytes[0]) << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3];
+	}
+
+	static uint64_t readBigEndian64(const uint8_t* bytes) {
+		return (static_cast<uint64_t>(readBigEndian32(bytes)) << 32) | readBigEndian32(bytes + 4);
+	}
+
+	// Compressed data of one table (one side to move and, with pawns, one leading pawn file)
+	struct PairsData {
+		uint8_t flags;
+		size_t block_size;
+		size_t span;
+		size_t sparse_index_size;
+		const uint8_t* sparse_index;	// 6 byte entries: block (4), offset (2)
+		size_t block_length_size;
+		const uint8_t* block_length;	// 16 bit entries
+		uint32_t blocks_count;
+		int max_symbol_length;
+		int min_symbol_length;			// single value tables store their value here
+		const uint8_t* lowest_symbol;	// 16 bit entries
+		const uint8_t* symbol_tree;		// 3 byte entries holding the two 12 bit children of each pair
+		const uint8_t* data;
+		std::vector<uint64_t> base;
+		std::vector<uint8_t> symbol_length;
+
+		std::array<int, MAX_PIECES> pieces;
+		std::array<int, MAX_PIECES + 1> group_length;
+		std::array<uint64_t, MAX_PIECES + 1> group_index;
+		std::array<uint16_t, 4> map_index;
+
+		int leftSymbol(int symbol) const {
+			const uint8_t* pair = symbol_tree + 3 * symbol;
+			return ((pair[1] & 0xF) << 8) | pair[0];
+		}
+
+		int rightSymbol(int symbol) const {
+			const uint8_t* pair = symbol_tree + 3 * symbol;
+			return (pair[2] << 4) | (pair[1] >> 4);
+		}
+	};
+
+	struct Table {
+		bool is_dtz;
+		std::string name;
+		uint64_t key;		// material key with the stronger side (the first in the name) as white
+		uint64_t key2;		// same material with the colors swapped
+		int piece_count;
+		bool has_pawns;
+		bool has_unique_pieces;
+		std::array<int, 2> pawn_count;	// leading color first
+
+		std::atomic<bool> ready;
+		bool failed;
+		mappedfile::MappedFile file;
+		const uint8_t* map;
+
+		std::array<std::array<PairsData, 4>, 2> items;
+
+		PairsData& get(int side, int file) {
+			return items[side][has_pawns ? file : 0];
+		}
+	};
+
+	struct TableEntry {
+		Table* wdl;
+		Table* dtz;
+	};
+
+	// Index encoding tables, computed once
+	struct Encoding {
+		std::array<std::array<uint64_t, 64>, MAX_PIECES> binomial;
+		std::array<int, 64> map_pawns;
+		std::array<int, 64> map_b1h1h7;
+		std::array<int, 64> map_a1d1d4;
+		std::array<std::array<int, 64>, 10> map_kk;
+		std::array<std::array<int, 64>, 6> lead_pawn_index;
+		std::array<std::array<int, 4>, 6> lead_pawns_size;
+
+		Encoding();
+	};
+
+	static int rankOf(int square) { return square >> 3; }
+	static int fileOf(int square) { return square & 7; }
+	static int offDiagonal(int square) { return rankOf(square) - fileOf(square); }
+	static int flipFile(int square) { return square ^ 7; }
+	static int flipRank(int square) { return square ^ 56; }
+
+	Encoding::Encoding() : binomial(), map_pawns(), map_b1h1h7(), map_a1d1d4(), map_kk(), lead_pawn_index(), lead_pawns_size() {
+		int code = 0;
+
+		for (int square = 0; square < 64; square++) {
+			if (offDiagonal(square) < 0)
+				map_b1h1h7[square] = code++;
+		}
+
+		// a1-d1-d4 triangle, the squares on the diagonal are numbered last
+		std::vector<int> diagonal;
+		code = 0;
+
+		for (int square = 0; square <= 27; square++) {
+			if (offDiagonal(square) < 0 && fileOf(square) <= 3)
+				map_a1d1d4[square] = code++;
+			else if (!offDiagonal(square) && fileOf(square) <= 3)
+				diagonal.push_back(square);
+		}
+
+		for (int square : diagonal)
+			map_a1d1d4[square] = code++;
+
+		// the 462 legal placements of two kings with the first one in the a1-d1-d4 triangle.
+		// With the first king on the diagonal the second one can't be above it.
+		std::vector<std::pair<int, int>> both_on_diagonal;
+		code = 0;
+
+		for (int index = 0; index < 10; index++) {
+			for (int first = 0; first <= 27; first++) {
+				if (map_a1d1d4[first] != index || (!index && first != 1))
+					continue;
+
+				for (int second = 0; second < 64; second++) {
+					if (std::abs(rankOf(first) - rankOf(second)) <= 1 && std::abs(fileOf(first) - fileOf(second)) <= 1)
+						continue;
+					else if (!offDiagonal(first) && offDiagonal(second) > 0)
+						continue;
+					else if (!offDiagonal(first) && !offDiagonal(second))
+						both_on_diagonal.emplace_back(index, second);
+					else
+						map_kk[index][second] = code++;
+				}
+			}
+		}
+
+		for (const auto& [index, second] : both_on_diagonal)
+			map_kk[index][second] = code++;
+
+		binomial[0][0] = 1;
+
+		for (int n = 1; n < 64; n++) {
+			for (int k = 0; k < MAX_PIECES && k <= n; k++) {
+				binomial[k][n] = (k > 0 ? binomial[k - 1][n - 1] : 0) + (k < n ? binomial[k][n - 1] : 0);
+			}
+		}
+
+		// map_pawns numbers a2-h7 so that the leading pawn, the one nearest to the edge and
+		// lowest on its file, has the highest value
+		int available_squares = 47;
+
+		for (int lead_pawns = 1; lead_pawns <= 5; lead_pawns++) {
+			for (int file = 0; file <= 3; file++) {
+				int index = 0;
+
+				for (int rank = 1; rank <= 6; rank++) {
+					int square = rank * 8 + file;
+
+					if (lead_pawns == 1) {
+						map_pawns[square] = available_squares--;
+						map_pawns[flipFile(square)] = available_squares--;
+					}
+
+					lead_pawn_index[lead_pawns][square] = index;
+					index += static_cast<int>(binomial[lead_pawns - 1][map_pawns[square]]);
+				}
+
+				lead_pawns_size[lead_pawns][file] = index;
+			}
+		}
+	}
+
+	static const Encoding encoding;
+
+	static std::vector<std::unique_ptr<Table>> tables;
+	static std::unordered_map<uint64_t, TableEntry> table_index;
+	static std::vector<std::string> table_paths;
+	static std::mutex mapping_mutex;
+	static int max_pieces = 0;
+
+	// Piece counts packed 5 bits per piece type, white pawn..king then black pawn..king
+	static uint64_t materialKey(const std::array<int, 7>& white, const std::array<int, 7>& black) {
+		uint64_t key = 0;
+
+		for (int type = 1; type <= 6; type++) {
+			key |= static_cast<uint64_t>(white[type]) << (5 * (type - 1));
+			key |= static_cast<uint64_t>(black[type]) << (5 * (type + 5));
+		}
+
+		return key;
+	}
+
+	static uint64_t materialKey(const board::BoardState& state) {
+		std::array<int, 7> white = {};
+		std::array<int, 7> black = {};
+
+		for (int type = 1; type <= 6; type++) {
+			white[type] = state.piece_count[type];
+			black[type] = state.piece_count[type + 6];
+		}
+
+		return materialKey(white, black);
+	}
+
+	// Generator piece code of a board piece
+	static int tablePiece(int piece) {
+		return piece <= asInt(constants::Piece::wK) ? piece : piece + 2;
+	}
+
+	static int pieceTypeFromChar(char c) {
+		switch (c) {
+		case 'P': return 1;
+		case 'N': return 2;
+		case 'B': return 3;
+		case 'R': return 4;
+		case 'Q': return 5;
+		case 'K': return 6;
+		default: return 0;
+		}
+	}
+
+	static void registerTable(const std::string& name) {
+		auto sides = util::splitString(name, "v");
+
+		if (sides.size() != 2 || sides[0].empty() || sides[1].empty())
+			return;
+
+		std::array<std::array<int, 7>, 2> counts = {};
+
+		for (int side = 0; side < 2; side++) {
+			for (char c : sides[side]) {
+				int type = pieceTypeFromChar(c);
+
+				if (!type)
+					return;
+
+				counts[side][type]++;
+			}
+
+			if (counts[side][6] != 1)
+				return;
+		}
+
+		uint64_t key = materialKey(counts[0], counts[1]);
+
+		if (table_index.count(key))
+			return;
+
+		auto wdl = std::make_unique<Table>();
+		wdl->is_dtz = false;
+		wdl->name = name;
+		wdl->key = key;
+		wdl->key2 = materialKey(counts[1], counts[0]);
+		wdl->piece_count = static_cast<int>(sides[0].size() + sides[1].size());
+		wdl->has_pawns = counts[0][1] + counts[1][1] > 0;
+		wdl->has_unique_pieces = false;
+
+		for (int side = 0; side < 2; side++) {
+			for (int type = 1; type < 6; type++) {
+				if (counts[side][type] == 1)
+					wdl->has_unique_pieces = true;
+			}
+		}
+
+		if (wdl->piece_count > MAX_PIECES)
+			return;
+
+		// with pawns on both sides the leading color is the one with fewer pawns
+		bool white_leads = !counts[1][1] || (counts[0][1] && counts[1][1] >= counts[0][1]);
+		wdl->pawn_count[0] = counts[white_leads ? 0 : 1][1];
+		wdl->pawn_count[1] = counts[white_leads ? 1 : 0][1];
+		wdl->ready = false;
+		wdl->failed = false;
+		wdl->map = nullptr;
+
+		auto dtz = std::make_unique<Table>();
+		dtz->is_dtz = true;
+		dtz->name = wdl->name;
+		dtz->key = wdl->key;
+		dtz->key2 = wdl->key2;
+		dtz->piece_count = wdl->piece_count;
+		dtz->has_pawns = wdl->has_pawns;
+		dtz->has_unique_pieces = wdl->has_unique_pieces;
+		dtz->pawn_count = wdl->pawn_count;
+		dtz->ready = false;
+		dtz->failed = false;
+		dtz->map = nullptr;
+
+		TableEntry entry = { wdl.get(), dtz.get() };
+		table_index[wdl->key] = entry;
+		table_index[wdl->key2] = entry;
+
+		max_pieces = std::max(max_pieces, wdl->piece_count);
+
+		tables.push_back(std::move(wdl));
+		tables.push_back(std::move(dtz));
+	}
+
+	void init(const std::string& paths) {
+		std::lock_guard<std::mutex> lock(mapping_mutex);
+
+		table_index.clear();
+		tables.clear();
+		table_paths.clear();
+		max_pieces = 0;
+
+		if (paths.empty() || paths == "<empty>")
+			return;
+
+#ifdef WIN32
+		table_paths = util::splitString(paths, ";");
+#else
+		table_paths = util::splitString(paths, ":");
+#endif
+
+		for (const auto& path : table_paths) {
+			std::error_code error;
+
+			for (const auto& file : std::filesystem::directory_iterator(path, error)) {
+				if (file.path().extension() == ".rtbw")
+					registerTable(file.path().stem().string());
+			}
+		}
+
+		std::cout << "info string Found " << tables.size() / 2 << " tablebases with up to " << max_pieces << " pieces" << std::endl;
+	}
+
+	int maxPieces() {
+		return max_pieces;
+	}
+
+	int pieceCount(const board::BoardState& state) {
+		int count = 0;
+
+		for (int piece = asInt(constants::Piece::wP); piece <= asInt(constants::Piece::bK); piece++)
+			count += state.piece_count[piece];
+
+		return count;
+	}
+
+	// The symbol tree pairs every symbol with two children, symbol_length[s] + 1 is the number of values s expands to
+	static int setSymbolLength(PairsData& d, int symbol, std::vector<bool>& visited) {
+		visited[symbol] = true;
+
+		int right = d.rightSymbol(symbol);
+
+		if (right == 0xFFF)
+			return 0;
+
+		int left = d.leftSymbol(symbol);
+
+		if (!visited[left])
+			d.symbol_length[left] = static_cast<uint8_t>(setSymbolLength(d, left, visited));
+
+		if (!visited[right])
+			d.symbol_length[right] = static_cast<uint8_t>(setSymbolLength(d, right, visited));
+
+		return d.symbol_length[left] + d.symbol_length[right] + 1;
+	}
+
+	static const uint8_t* setSizes(PairsData& d, const uint8_t* data) {
+		d.flags = *data++;
+
+		if (d.flags & FLAG_SINGLE_VALUE) {
+			d.blocks_count = 0;
+			d.block_length_size = 0;
+			d.span = 0;
+			d.sparse_index_size = 0;
+			d.min_symbol_length = *data++;
+			return data;
+		}
+
+		// the last group index holds the size of the whole table
+		int groups = 0;
+
+		while (d.group_length[groups])
+			groups++;
+
+		uint64_t table_size = d.group_index[groups];
+
+		d.block_size = size_t(1) << *data++;
+		d.span = size_t(1) << *data++;
+		d.sparse_index_size = static_cast<size_t>((table_size + d.span - 1) / d.span);
+		int padding = *data++;
+		d.blocks_count = readLittleEndian32(data);
+		data += 4;
+		d.block_length_size = d.blocks_count + padding;
+		d.max_symbol_length = *data++;
+		d.min_symbol_length = *data++;
+		d.lowest_symbol = data;
+
+		// Canonical Huffman code: longer codes have lower values. base[i] is the lowest code of length
+		// min_symbol_length + i, left aligned to 64 bits, so the length of a code is found by comparing against it.
+		d.base.assign(d.max_symbol_length - d.min_symbol_length + 1, 0);
+
+		for (int i = static_cast<int>(d.base.size()) - 2; i >= 0; i--) {
+			d.base[i] = (d.base[i + 1] + readLittleEndian16(d.lowest_symbol + 2 * i) - readLittleEndian16(d.lowest_symbol + 2 * (i + 1))) / 2;
+		}
+
+		for (size_t i = 0; i < d.base.size(); i++) {
+			d.base[i] <<= 64 - i - d.min_symbol_length;
+		}
+
+		data += d.base.size() * 2;
+
+		d.symbol_length.assign(readLittleEndian16(data), 0);
+		data += 2;
+		d.symbol_tree = data;
+
+		std::vector<bool> visited(d.symbol_length.size());
+
+		for (int symbol = 0; symbol < static_cast<int>(d.symbol_length.size()); symbol++) {
+			if (!visited[symbol])
+				d.symbol_length[symbol] = static_cast<uint8_t>(setSymbolLength(d, symbol, visited));
+		}
+
+		return data + d.symbol_length.size() * 3 + (d.symbol_length.size() & 1);
+	}
+
+	// Groups of pieces are encoded together. The order the groups are encoded in is stored per table.
+	static void setGroups(Table& e, PairsData& d, const std::array<int, 2>& order, int file) {
+		int n = 0;
+		int first_length = e.has_pawns ? 0 : e.has_unique_pieces ? 3 : 2;
+		d.group_length[n] = 1;
+
+		for (int i = 1; i < e.piece_count; i++) {
+			if (--first_length > 0 || d.pieces[i] == d.pieces[i - 1])
+				d.group_length[n]++;
+			else
+				d.group_length[++n] = 1;
+		}
+
+		d.group_length[++n] = 0;
+
+		bool pawns_on_both_sides = e.has_pawns && e.pawn_count[1];
+		int next = pawns_on_both_sides ? 2 : 1;
+		int free_squares = 64 - d.group_length[0] - (pawns_on_both_sides ? d.group_length[1] : 0);
+		uint64_t index = 1;
+
+		for (int k = 0; next < n || k == order[0] || k == order[1]; k++) {
+			if (k == order[0]) {
+				d.group_index[0] = index;
+				index *= e.has_pawns ? encoding.lead_pawns_size[d.group_length[0]][file] : e.has_unique_pieces ? 31332 : 462;
+			}
+			else if (k == order[1]) {
+				d.group_index[1] = index;
+				index *= encoding.binomial[d.group_length[1]][48 - d.group_length[0]];
+			}
+			else {
+				d.group_index[next] = index;
+				index *= encoding.binomial[d.group_length[next]][free_squares];
+				free_squares -= d.group_length[next++];
+			}
+		}
+
+		d.group_index[n] = index;
+	}
+
+	static const uint8_t* setDtzMap(Table& e, const uint8_t* data, int max_file) {
+		e.map = data;
+
+		for (int file = 0; file <= max_file; file++) {
+			PairsData& d = e.get(0, file);
+
+			if (!(d.flags & FLAG_MAPPED))
+				continue;
+
+			if (d.flags & FLAG_WIDE) {
+				data += reinterpret_cast<uintptr_t>(data) & 1;
+
+				for (int i = 0; i < 4; i++) {
+					d.map_index[i] = static_cast<uint16_t>(((data - e.map) >> 1) + 1);
+					data += 2 * readLittleEndian16(data) + 2;
+				}
+			}
+			else {
+				for (int i = 0; i < 4; i++) {
+					d.map_index[i] = static_cast<uint16_t>(data - e.map + 1);
+					data += *data + 1;
+				}
+			}
+		}
+
+		return data + (reinterpret_cast<uintptr_t>(data) & 1);
+	}
+
+	static void initTable(Table& e, const uint8_t* data) {
+		data++; // flags
+
+		int sides = !e.is_dtz && e.key != e.key2 ? 2 : 1;
+		int max_file = e.has_pawns ? 3 : 0;
+		bool pawns_on_both_sides = e.has_pawns && e.pawn_count[1];
+
+		for (int file = 0; file <= max_file; file++) {
+			std::array<std::array<int, 2>, 2> order = { {
+				{ *data & 0xF, pawns_on_both_sides ? *(data + 1) & 0xF : 0xF },
+				{ *data >> 4, pawns_on_both_sides ? *(data + 1) >> 4 : 0xF }
+			} };
+
+			data += 1 + pawns_on_both_sides;
+
+			for (int k = 0; k < e.piece_count; k++, data++) {
+				for (int side = 0; side < sides; side++)
+					e.get(side, file).pieces[k] = side ? *data >> 4 : *data & 0xF;
+			}
+
+			for (int side = 0; side < sides; side++)
+				setGroups(e, e.get(side, file), order[side], file);
+		}
+
+		data += reinterpret_cast<uintptr_t>(data) & 1;
+
+		for (int file = 0; file <= max_file; file++) {
+			for (int side = 0; side < sides; side++)
+				data = setSizes(e.get(side, file), data);
+		}
+
+		if (e.is_dtz)
+			data = setDtzMap(e, data, max_file);
+
+		for (int file = 0; file <= max_file; file++) {
+			for (int side = 0; side < sides; side++) {
+				PairsData& d = e.get(side, file);
+				d.sparse_index = data;
+				data += d.sparse_index_size * 6;
+			}
+		}
+
+		for (int file = 0; file <= max_file; file++) {
+			for (int side = 0; side < sides; side++) {
+				PairsData& d = e.get(side, file);
+				d.block_length = data;
+				data += d.block_length_size * 2;
+			}
+		}
+
+		for (int file = 0; file <= max_file; file++) {
+			for (int side = 0; side < sides; side++) {
+				PairsData& d = e.get(side, file);
+				data = reinterpret_cast<const uint8_t*>((reinterpret_cast<uintptr_t>(data) + 0x3F) & ~uintptr_t(0x3F));
+				d.data = data;
+				data += static_cast<size_t>(d.blocks_count) * d.block_size;
+			}
+		}
+	}
+
+	// Maps the table file on first use, every thread probing the same table waits for the first one
+	static bool mapTable(Table& e) {
+		if (e.ready.load(std::memory_order_acquire))
+			return true;
+
+		std::lock_guard<std::mutex> lock(mapping_mutex);
+
+		if (e.ready.load(std::memory_order_relaxed))
+			return true;
+
+		if (e.failed)
+			return false;
+
+		const auto& magic = e.is_dtz ? DTZ_MAGIC : WDL_MAGIC;
+		std::string file_name = e.name + (e.is_dtz ? ".rtbz" : ".rtbw");
+
+		for (const auto& path : table_paths) {
+			if (!e.file.open((std::filesystem::path(path) / file_name).string()))
+				continue;
+
+			const uint8_t* data = e.file.getData();
+
+			if (e.file.getSize() % 64 != 16 || !std::equal(magic.begin(), magic.end(), data)) {
+				std::cout << "info string Corrupted tablebase file " << file_name << std::endl;
+				e.file.close();
+				continue;
+			}
+
+			initTable(e, data + 4);
+			e.ready.store(true, std::memory_order_release);
+			return true;
+		}
+
+		e.failed = true;
+		return false;
+	}
+
+	static int decompressPairs(const PairsData& d, uint64_t index) {
+		if (d.flags & FLAG_SINGLE_VALUE)
+			return d.min_symbol_length;
+
+		// The sparse index points at the block and offset of every span-th value, from there
+		// the block lengths (values per block - 1) are walked to the block holding our value
+		uint32_t k = static_cast<uint32_t>(index / d.span);
+		uint32_t block = readLittleEndian32(d.sparse_index + 6 * k);
+		int offset = readLittleEndian16(d.sparse_index + 6 * k + 4);
+
+		offset += static_cast<int>(index % d.span) - static_cast<int>(d.span / 2);
+
+		while (offset < 0)
+			offset += readLittleEndian16(d.block_length + 2 * --block) + 1;
+
+		while (offset > readLittleEndian16(d.block_length + 2 * block))
+			offset -= readLittleEndian16(d.block_length + 2 * block++) + 1;
+
+		const uint8_t* ptr = d.data + static_cast<uint64_t>(block) * d.block_size;
+
+		uint64_t buffer = readBigEndian64(ptr);
+		ptr += 8;
+		int buffer_size = 64;
+		int symbol;
+
+		while (true) {
+			int length = 0;
+
+			while (buffer < d.base[length])
+				length++;
+
+			symbol = static_cast<int>((buffer - d.base[length]) >> (64 - length - d.min_symbol_length));
+			symbol += readLittleEndian16(d.lowest_symbol + 2 * length);
+
+			if (offset < d.symbol_length[symbol] + 1)
+				break;
+
+			offset -= d.symbol_length[symbol] + 1;
+			length += d.min_symbol_length;
+			buffer <<= length;
+			buffer_size -= length;
+
+			if (buffer_size <= 32) {
+				buffer_size += 32;
+				buffer |= static_cast<uint64_t>(readBigEndian32(ptr)) << (64 - buffer_size);
+				ptr += 4;
+			}
+		}
+
+		// expand the pair symbols until we reach the single value at our offset
+		while (d.symbol_length[symbol]) {
+			int left = d.leftSymbol(symbol);
+
+			if (offset < d.symbol_length[left] + 1) {
+				symbol = left;
+			}
+			else {
+				offset -= d.symbol_length[left] + 1;
+				symbol = d.rightSymbol(symbol);
+			}
+		}
+
+		return d.leftSymbol(symbol);
+	}
+
+	static int mapScore(Table& e, int file, int value, WDLScore wdl) {
+		if (!e.is_dtz)
+			return value - 2;
+
+		constexpr std::array<int, 5> WDL_MAP = { 1, 3, 0, 2, 0 };
+		const PairsData& d = e.get(0, file);
+
+		if (d.flags & FLAG_MAPPED) {
+			int index = d.map_index[WDL_MAP[wdl + 2]] + value;
+
+			if (d.flags & FLAG_WIDE)
+				value = readLittleEndian16(e.map + 2 * index);
+			else
+				value = e.map[index];
+		}
+
+		// the table stores moves unless the plies flag is set
+		if ((wdl == WDL_WIN && !(d.flags & FLAG_WIN_PLIES)) || (wdl == WDL_LOSS && !(d.flags & FLAG_LOSS_PLIES)) ||
+			wdl == WDL_CURSED_WIN || wdl == WDL_BLESSED_LOSS)
+			value *= 2;
+
+		return value + 1;
+	}
+
+	static int probeTable(board::BoardState& state, Table& e, WDLScore wdl, ProbeState& result) {
+		std::array<int, MAX_PIECES> squares;
+		std::array<int, MAX_PIECES> pieces;
+		int size = 0;
+		int lead_pawns_count = 0;
+		int table_file = 0;
+		uint64_t index;
+
+		auto pawn_compare = [](int a, int b) { return encoding.map_pawns[a] < encoding.map_pawns[b]; };
+
+		// Tables are built with the stronger side as white and symmetric tables only for white to move,
+		// other positions are looked up with colors swapped and the board flipped
+		bool flip = (e.key == e.key2 && state.player == constants::Color::BLACK) || materialKey(state) != e.key;
+		int flip_color = flip ? 8 : 0;
+		int flip_squares = flip ? 56 : 0;
+		int side = flip ^ (state.player == constants::Color::BLACK);
+
+		int lead_pawn = -1;
+
+		if (e.has_pawns) {
+			// pawns of the leading color come first in every piece sequence
+			int pawn = e.get(0, 0).pieces[0] ^ flip_color;
+			lead_pawn = pawn == 1 ? asInt(constants::Piece::wP) : asInt(constants::Piece::bP);
+
+			for (int square : state.piece_list[lead_pawn])
+				squares[size++] = util::_120To64(square) ^ flip_squares;
+
+			lead_pawns_count = size;
+			std::swap(squares[0], *std::max_element(squares.begin(), squares.begin() + lead_pawns_count, pawn_compare));
+			table_file = std::min(fileOf(squares[0]), 7 - fileOf(squares[0]));
+		}
+
+		// DTZ tables are one sided
+		if (e.is_dtz) {
+			int flags = e.get(0, table_file).flags;
+
+			if ((flags & FLAG_STM) != side && !(e.key == e.key2 && !e.has_pawns)) {
+				result = ProbeState::CHANGE_STM;
+				return 0;
+			}
+		}
+
+		for (int piece = asInt(constants::Piece::wP); piece <= asInt(constants::Piece::bK); piece++) {
+			if (piece == lead_pawn)
+				continue;
+
+			for (int square : state.piece_list[piece]) {
+				squares[size] = util::_120To64(square) ^ flip_squares;
+				pieces[size++] = tablePiece(piece) ^ flip_color;
+			}
+		}
+
+		PairsData& d = e.get(e.is_dtz ? 0 : side, table_file);
+
+		// reorder the pieces to the sequence used by the table
+		for (int i = lead_pawns_count; i < size - 1; i++) {
+			for (int j = i + 1; j < size; j++) {
+				if (d.pieces[i] == pieces[j]) {
+					std::swap(pieces[i], pieces[j]);
+					std::swap(squares[i], squares[j]);
+					break;
+				}
+			}
+		}
+
+		// the leading piece goes to the a-d files
+		if (fileOf(squares[0]) > 3) {
+			for (int i = 0; i < size; i++)
+				squares[i] = flipFile(squares[i]);
+		}
+
+		if (e.has_pawns) {
+			index = encoding.lead_pawn_index[lead_pawns_count][squares[0]];
+			std::stable_sort(squares.begin() + 1, squares.begin() + lead_pawns_count, pawn_compare);
+
+			for (int i = 1; i < lead_pawns_count; i++)
+				index += encoding.binomial[i][encoding.map_pawns[squares[i]]];
+		}
+		else {
+			// without pawns the leading piece also goes below the fifth rank and below the a1-h8 diagonal
+			if (rankOf(squares[0]) > 3) {
+				for (int i = 0; i < size; i++)
+					squares[i] = flipRank(squares[i]);
+			}
+
+			for (int i = 0; i < d.group_length[0]; i++) {
+				if (!offDiagonal(squares[i]))
+					continue;
+
+				if (offDiagonal(squares[i]) > 0) {
+					for (int j = i; j < size; j++)
+						squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+				}
+
+				break;
+			}
+
+			if (e.has_unique_pieces) {
+				// the first three pieces are encoded together
+				int adjust1 = squares[1] > squares[0];
+				int adjust2 = (squares[2] > squares[0]) + (squares[2] > squares[1]);
+
+				if (offDiagonal(squares[0]))
+					index = (encoding.map_a1d1d4[squares[0]] * 63 + (squares[1] - adjust1)) * 62 + squares[2] - adjust2;
+				else if (offDiagonal(squares[1]))
+					index = (6 * 63 + rankOf(squares[0]) * 28 + encoding.map_b1h1h7[squares[1]]) * 62 + squares[2] - adjust2;
+				else if (offDiagonal(squares[2]))
+					index = 6 * 63 * 62 + 4 * 28 * 62 + rankOf(squares[0]) * 7 * 28 + (rankOf(squares[1]) - adjust1) * 28 + encoding.map_b1h1h7[squares[2]];
+				else
+					index = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + rankOf(squares[0]) * 7 * 6 + (rankOf(squares[1]) - adjust1) * 6 + (rankOf(squares[2]) - adjust2);
+			}
+			else {
+				index = encoding.map_kk[encoding.map_a1d1d4[squares[0]]][squares[1]];
+			}
+		}
+
+		index *= d.group_index[0];
+
+		// remaining pawns and pieces, each group in ascending square order and skipping the squares taken by earlier groups
+		int group_start = d.group_length[0];
+		bool remaining_pawns = e.has_pawns && e.pawn_count[1];
+		int next = 0;
+
+		while (d.group_length[++next]) {
+			int group_end = group_start + d.group_length[next];
+			std::stable_sort(squares.begin() + group_start, squares.begin() + group_end);
+			uint64_t n = 0;
+
+			for (int i = 0; i < d.group_length[next]; i++) {
+				int square = squares[group_start + i];
+				int adjust = static_cast<int>(std::count_if(squares.begin(), squares.begin() + group_start, [square](int other) { return square > other; }));
+				n += encoding.binomial[i + 1][square - adjust - 8 * remaining_pawns];
+			}
+
+			remaining_pawns = false;
+			index += n * d.group_index[next];
+			group_start = group_end;
+		}
+
+		return mapScore(e, table_file, decompressPairs(d, index), wdl);
+	}
+
+	static int probeTable(board::BoardState& state, bool dtz, WDLScore wdl, ProbeState& result) {
+		if (pieceCount(state) == 2)
+			return WDL_DRAW;
+
+		auto it = table_index.find(materialKey(state));
+
+		if (it == table_index.end()) {
+			result = ProbeState::FAIL;
+			return 0;
+		}
+
+		Table& e = dtz ? *it->second.dtz : *it->second.wdl;
+
+		if (!mapTable(e)) {
+			result = ProbeState::FAIL;
+			return 0;
+		}
+
+		return probeTable(state, e, wdl, result);
+	}
+
+	static bool isCapture(const move::Move& move) {
+		return move.captured || move.en_passant;
+	}
+
+	// The tables don't know about en passant and can be wrong when the best move is a capture,
+	// so captures (and with check_zeroing_moves pawn moves) are searched before the table is probed
+	static WDLScore search(board::BoardState& state, ProbeState& result, bool check_zeroing_moves) {
+		WDLScore best_value = WDL_LOSS;
+		WDLScore value;
+		int total_count = 0;
+		int move_count = 0;
+
+		for (const auto& move : movegen::generateAllMoves(state)) {
+			bool zeroing = isCapture(move) || (check_zeroing_moves && !constants::IS_NOT_PAWN[state.pieces[move.from]]);
+
+			if (!state.step(move))
+				continue;
+
+			total_count++;
+
+			if (!zeroing) {
+				state.undo();
+				continue;
+			}
+
+			move_count++;
+			value = static_cast<WDLScore>(-search(state, result, false));
+			state.undo();
+
+			if (result == ProbeState::FAIL)
+				return WDL_DRAW;
+
+			if (value > best_value) {
+				best_value = value;
+
+				if (value >= WDL_WIN) {
+					result = ProbeState::ZEROING_BEST_MOVE;
+					return value;
+				}
+			}
+		}
+
+		bool no_more_moves = move_count && move_count == total_count;
+
+		if (no_more_moves) {
+			value = best_value;
+		}
+		else {
+			value = static_cast<WDLScore>(probeTable(state, false, WDL_DRAW, result));
+
+			if (result == ProbeState::FAIL)
+				return WDL_DRAW;
+		}
+
+		if (best_value >= value) {
+			result = best_value > WDL_DRAW || no_more_moves ? ProbeState::ZEROING_BEST_MOVE : ProbeState::OK;
+			return best_value;
+		}
+
+		result = ProbeState::OK;
+		return value;
+	}
+
+	WDLScore probeWDL(board::BoardState& state, ProbeState& result) {
+		result = ProbeState::OK;
+		return search(state, result, false);
+	}
+
+	static int dtzBeforeZeroing(WDLScore wdl) {
+		switch (wdl) {
+		case WDL_WIN: return 1;
+		case WDL_CURSED_WIN: return 101;
+		case WDL_BLESSED_LOSS: return -101;
+		case WDL_LOSS: return -1;
+		default: return 0;
+		}
+	}
+
+	static int sign(int value) {
+		return (value > 0) - (value < 0);
+	}
+
+	int probeDTZ(board::BoardState& state, ProbeState& result) {
+		result = ProbeState::OK;
+		WDLScore wdl = search(state, result, true);
+
+		if (result == ProbeState::FAIL || wdl == WDL_DRAW)
+			return 0;
+
+		if (result == ProbeState::ZEROING_BEST_MOVE)
+			return dtzBeforeZeroing(wdl);
+
+		int dtz = probeTable(state, true, wdl, result);
+
+		if (result == ProbeState::FAIL)
+			return 0;
+
+		if (result != ProbeState::CHANGE_STM)
+			return (dtz + 100 * (wdl == WDL_BLESSED_LOSS || wdl == WDL_CURSED_WIN)) * sign(wdl);
+
+		// the table is stored for the other side to move, take the best DTZ after one ply
+		int min_dtz = 0xFFFF;
+
+		for (const auto& move : movegen::generateAllMoves(state)) {
+			bool zeroing = isCapture(move) || !constants::IS_NOT_PAWN[state.pieces[move.from]];
+
+			if (!state.step(move))
+				continue;
+
+			// for zeroing moves the DTZ before the move is wanted, the WDL after it gives its sign
+			dtz = zeroing ? -dtzBeforeZeroing(search(state, result, false)) : -probeDTZ(state, result);
+
+			if (dtz == 1 && attack::isInCheck(state) && !movegen::hasLegalMove(state))
+				min_dtz = 1;
+
+			if (!zeroing)
+				dtz += sign(dtz);
+
+			if (dtz < min_dtz && sign(dtz) == sign(wdl))
+				min_dtz = dtz;
+
+			state.undo();
+
+			if (result == ProbeState::FAIL)
+				return 0;
+		}
+
+		return min_dtz == 0xFFFF ? -1 : min_dtz;
+	}
+
+	bool probeRoot(board::BoardState& state, move::Move& best_move, int& score) {
+		ProbeState result = ProbeState::OK;
+		int fifty_move = state.fifty_move;
+		int best_rank = -MAX_DTZ - 1;
+		int best_dtz = 0;
+
+		for (const auto& move : movegen::generateAllMoves(state)) {
+			if (!state.step(move))
+				continue;
+
+			int dtz;
+
+			if (state.fifty_move == 0) {
+				// zeroing move, dtz is one of -101/-1/0/1/101
+				dtz = dtzBeforeZeroing(static_cast<WDLScore>(-probeWDL(state, result)));
+			}
+			else if (state.isRepetition() || state.fifty_move >= 100) {
+				dtz = 0;
+			}
+			else {
+				dtz = -probeDTZ(state, result);
+				dtz = dtz > 0 ? dtz + 1 : dtz < 0 ? dtz - 1 : dtz;
+			}
+
+			if (dtz == 2 && attack::isInCheck(state) && !movegen::hasLegalMove(state))
+				dtz = 1;
+
+			state.undo();
+
+			if (result == ProbeState::FAIL)
+				return false;
+
+			// Wins within the fifty move limit rank equally, cursed wins are ranked by how close they get.
+			// Losses rank equally unless the fifty move rule can save the game.
+			int rank = dtz > 0 ? (dtz + fifty_move <= 99 ? MAX_DTZ : MAX_DTZ - (dtz + fifty_move))
+				: dtz < 0 ? (-dtz * 2 + fifty_move < 100 ? -MAX_DTZ : -MAX_DTZ + (-dtz + fifty_move))
+				: 0;
+
+			// among equally ranked moves, win fastest and lose slowest
+			bool better = rank > best_rank || (rank == best_rank && ((dtz > 0 && dtz < best_dtz) || (dtz < 0 && dtz < best_dtz)));
+
+			if (best_move.isNull() || better) {
+				best_move = move;
+				best_rank = rank;
+				best_dtz = dtz;
+			}
+		}
+
+		if (best_move.isNull())
+			return false;
+
+		if (best_rank >= MAX_DTZ - 100)
+			score = constants::TB_WIN - best_dtz;
+		else if (best_rank > 0)
+			score = std::max(3, best_rank - (MAX_DTZ - 200)) * constants::PIECE_VALUE[asInt(constants::Piece::wP)] / 200;
+		else if (best_rank == 0)
+			score = 0;
+		else if (best_rank > -(MAX_DTZ - 100))
+			score = std::min(-3, best_rank + (MAX_DTZ - 200)) * constants::PIECE_VALUE[asInt(constants::Piece::wP)] / 200;
+		else
+			score = -constants::TB_WIN - best_dtz;
+
+		return true;
+	}
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+
+#include "board.hpp"
+#include "move.hpp"
+
+namespace tablebase {
+
+	// Win/draw/loss from the point of view of the side to move. Cursed wins and blessed losses
+	// are wins and losses that can't be converted before the fifty move rule kicks in.
+	enum WDLScore {
+		WDL_LOSS = -2,
+		WDL_BLESSED_LOSS = -1,
+		WDL_DRAW = 0,
+		WDL_CURSED_WIN = 1,
+		WDL_WIN = 2
+	};
+
+	enum class ProbeState {
+		FAIL,
+		OK,
+		CHANGE_STM,			// DTZ table stores the other side to move
+		ZEROING_BEST_MOVE	// the best move is a capture or pawn move, the table value can't be used
+	};
+
+	// Scans the directories in paths (separated by ':', ';' on Windows) for Syzygy .rtbw/.rtbz files.
+	// Tables are only registered here, every file is memory-mapped the first time it gets probed.
+	// An empty path or "<empty>" unloads all tables.
+	void init(const std::string& paths);
+
+	// Largest number of pieces (kings included) for which a WDL table was found, 0 without tablebases.
+	int maxPieces();
+
+	int pieceCount(const board::BoardState& state);
+
+	// Both probes expect a position without castling rights. The DTZ probe returns plies to the
+	// next capture or pawn move, signed like the WDL score and 0 for draws.
+	WDLScore probeWDL(board::BoardState& state, ProbeState& result);
+	int probeDTZ(board::BoardState& state, ProbeState& result);
+
+	// Picks the root move with the best DTZ ranking, respecting the fifty move rule.
+	// Returns false if a needed table is missing. score is set from the point of view of the side to move.
+	bool probeRoot(board::BoardState& state, move::Move& best_move, int& score);
+
+}
@@ -5,8 +5,14 @@
 #include "util.hpp"
 #include "bitboard.hpp"
 #include "board.hpp"
+#include "attack.hpp"
 #include "constants.hpp"
 #include "perft.hpp"
+#include "evaluate.hpp"
+#include "book.hpp"
+#include "gensfen.hpp"
+#include "san.hpp"
+#include "uci.hpp"
 
 inline void testAll() {
 
@@ -18,6 +24,16 @@ inline void testAll() {
         }
     }
 
+    // kings aren't material, but a capture by the king still orders behind one by any other piece
+    assert(util::getCapturePriority(constants::Piece::wK, constants::Piece::bQ) < util::getCapturePriority(constants::Piece::wP, constants::Piece::bP));
+    assert(constants::PIECE_VALUE[asInt(constants::Piece::wK)] == 0);
+
+    // e2 pawns take on d3 and f3 or d1 and f1, an a-pawn only towards the b-file
+    static_assert(attack::PAWN_ATTACKS[0][12] == ((1ULL << 19) | (1ULL << 21)));
+    static_assert(attack::PAWN_ATTACKS[1][12] == ((1ULL << 3) | (1ULL << 5)));
+    static_assert(attack::PAWN_ATTACKS[0][8] == (1ULL << 17));
+    static_assert(attack::KNIGHT_ATTACKS[0] == ((1ULL << 10) | (1ULL << 17)));
+
     bitboard::Bitboard board = 0;
     board = bitboard::setBitAt(board, 0);
     board = bitboard::setBitAt(board, 63);
@@ -36,5 +52,64 @@ inline void testAll() {
     state.loadFromFen(constants::FEN_START_POS);
     perft::perftTest(3, state);
 
+    // colour-mirrored positions have to evaluate the same for the side to move
+    assert(evaluate::evaluatePosition(state) == 0);
+    state.loadFromFen("r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4");
+    [[maybe_unused]] int white_score = evaluate::evaluatePosition(state);
+    state.loadFromFen("rnbqk2r/pppp1ppp/5n2/2b1p3/4P3/2N2N2/PPPP1PPP/R1BQKB1R b KQkq - 4 4");
+    assert(evaluate::evaluatePosition(state) == white_score);
+
+    // reference keys from the Polyglot format description
+    state.loadFromFen(constants::FEN_START_POS);
+    assert(book::polyglotKey(state) == 0x463b96181691fc9cULL);
+    state.loadFromFen("rnbqkbnr/ppp1pppp/8/3p4/4P3/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 2");
+    assert(book::polyglotKey(state) == 0x0756b94461c50fb0ULL);
+    state.loadFromFen("rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3");
+    assert(book::polyglotKey(state) == 0x22a48b5a8e47ff78ULL);
+    state.loadFromFen("rnbq1bnr/ppp1pkpp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR w - - 0 4");
+    assert(book::polyglotKey(state) == 0x00fdd303c946bdd9ULL);
+
+    // knights going back and forth: after Ng1 black can repeat the position with Ng8, which then is a repetition
+    using constants::Square;
+    auto quiet = [](Square from, Square to) { return move::Move(asInt(from), asInt(to), 0, false, false, 0, false, 0); };
+
+    state.loadFromFen(constants::FEN_START_POS);
+    state.step(quiet(Square::E2, Square::E4));
+    state.step(quiet(Square::E7, Square::E5));
+    state.step(quiet(Square::G1, Square::F3));
+    state.step(quiet(Square::G8, Square::F6));
+    state.step(quiet(Square::F3, Square::G1));
+    assert(!state.isRepetition());
+    assert(state.hasUpcomingRepetition());
+    state.step(quiet(Square::F6, Square::G8));
+    assert(state.isRepetition());
+
+    // packed training positions turn back into the same position
+    state.loadFromFen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R b Kq e3 3 1");
+    int packed_score;
+    int packed_result;
+    std::string packed_fen = gensfen::unpack(gensfen::pack(state, -123, 1), packed_score, packed_result);
+    assert(packed_fen == "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R b Kq e3 3 1");
+    assert(packed_score == -123 && packed_result == 1);
+    assert(state.toFen() == "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R b Kq e3 3 1");
+
+    // SAN as found in PGN files
+    assert(san::parseSan(state, "O-O-O").toString() == "e8c8");
+    assert(san::parseSan(state, "Nxe4").toString() == "f6e4");
+    assert(san::parseSan(state, "bxc3!?").toString() == "b4c3");
+    assert(san::parseSan(state, "hxg2").toString() == "h3g2");
+    assert(san::parseSan(state, "Nb6d5").toString() == "b6d5");
+    assert(san::parseSan(state, "Nd5").isNull()); // ambiguous
+    assert(san::parseSan(state, "Ke7").isNull()); // illegal
+    assert(san::toSan(state, san::parseSan(state, "O-O-O")) == "O-O-O");
+    assert(san::toSan(state, san::parseSan(state, "Nbxd5")) == "Nbxd5");
+    assert(san::toSan(state, san::parseSan(state, "bxc3")) == "bxc3");
+    assert(san::toSan(state, uci::parseMove(state, "e7c5")) == "Qc5");
+    state.loadFromFen("6k1/5ppp/8/8/8/8/6PK/R6R w - - 0 1");
+    assert(san::toSan(state, uci::parseMove(state, "a1a8")) == "Ra8#");
+    assert(san::toSan(state, uci::parseMove(state, "h1d1")) == "Rhd1");
+    state.loadFromFen("8/P5k1/8/8/8/8/8/4K3 w - - 0 1");
+    assert(san::toSan(state, uci::parseMove(state, "a7a8n")) == "a8=N");
+
 }
 
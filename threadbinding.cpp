@@ -0,0 +1,119 @@
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <map>
+#include <tuple>
+#include <filesystem>
+#include <algorithm>
+
+#include "threadbinding.hpp"
+
+namespace threadbinding {
+
+	static std::atomic<bool> binding_enabled = false;
+
+	void setEnabled(bool enabled) {
+		binding_enabled = enabled;
+	}
+
+	bool isEnabled() {
+		return binding_enabled;
+	}
+
+#ifdef __linux__
+	static int readNumber(const std::string& path, int fallback) {
+		std::ifstream file(path);
+		int value;
+		return file >> value ? value : fallback;
+	}
+
+	static int numaNode(int cpu) {
+		std::error_code error;
+
+		for (const auto& entry : std::filesystem::directory_iterator("/sys/devices/system/cpu/cpu" + std::to_string(cpu), error)) {
+			std::string name = entry.path().filename().string();
+
+			if (name.rfind("node", 0) == 0 && name.size() > 4 && std::isdigit(name[4]))
+				return std::stoi(name.substr(4));
+		}
+
+		return 0;
+	}
+
+	static std::vector<int> readCpuOrder() {
+		struct Cpu {
+			int id;
+			int node;
+			// 0 for the first logical CPU of a core, 1 for its first SMT sibling and so on
+			int sibling;
+			// position among the CPUs of the same node and sibling rank
+			int slot;
+		};
+
+		cpu_set_t allowed;
+		CPU_ZERO(&allowed);
+
+		if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+			return {};
+
+		std::vector<Cpu> cpus;
+		std::map<std::pair<int, int>, int> core_siblings;
+		std::map<std::pair<int, int>, int> node_slots;
+
+		for (int id = 0; id < CPU_SETSIZE; id++) {
+			if (!CPU_ISSET(id, &allowed))
+				continue;
+
+			std::string topology = "/sys/devices/system/cpu/cpu" + std::to_string(id) + "/topology/";
+			int package = readNumber(topology + "physical_package_id", 0);
+			// without topology information every CPU counts as a core of its own
+			int core = readNumber(topology + "core_id", id);
+
+			Cpu cpu = { id, numaNode(id), core_siblings[{ package, core }]++, 0 };
+			cpu.slot = node_slots[{ cpu.node, cpu.sibling }]++;
+			cpus.push_back(cpu);
+		}
+
+		std::stable_sort(cpus.begin(), cpus.end(), [](const Cpu& a, const Cpu& b) {
+			return std::tie(a.sibling, a.slot, a.node) < std::tie(b.sibling, b.slot, b.node);
+		});
+
+		std::vector<int> order;
+
+		for (const auto& cpu : cpus)
+			order.push_back(cpu.id);
+
+		return order;
+	}
+
+	const std::vector<int>& cpuOrder() {
+		static const std::vector<int> order = readCpuOrder();
+		return order;
+	}
+
+	void bindThisThread(int index) {
+		const std::vector<int>& order = cpuOrder();
+
+		if (!binding_enabled || order.empty())
+			return;
+
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(order[index % order.size()], &set);
+		pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	}
+#else
+	const std::vector<int>& cpuOrder() {
+		static const std::vector<int> order;
+		return order;
+	}
+
+	void bindThisThread(int index) {}
+#endif
+
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <vector>
+
+namespace threadbinding {
+
+	// Off by default: pinning only pays when nothing else competes for the cores
+	void setEnabled(bool enabled);
+	bool isEnabled();
+
+	// Logical CPUs this process may run on, in the order workers take them: one per physical core first, with
+	// consecutive workers alternating between NUMA nodes, then the SMT siblings in the same order.
+	// Read from /sys/devices/system/cpu once, empty where the topology isn't known.
+	const std::vector<int>& cpuOrder();
+
+	// Pins the calling thread to the CPU of worker index. Binding stays within the CPUs the process was
+	// started on, so several engines on one machine are kept apart with taskset. Does nothing when disabled.
+	void bindThisThread(int index);
+
+}
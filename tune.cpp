@@ -0,0 +1,573 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <stdexcept>
+#include <vector>
+#include <array>
+#include <thread>
+#include <cmath>
+#include <cctype>
+#include <cinttypes>
+
+#include "board.hpp"
+#include "constants.hpp"
+#include "evaluate.hpp"
+#include "search.hpp"
+#include "util.hpp"
+
+// Texel tuning of the evaluation parameters in evalparams.hpp.
+//
+// Every position of the dataset is first resolved to a quiet one by following the quiescence search PV.
+// The evaluation is linear in its parameters once the phase is known, so each quiet position is stored
+// as the phase plus a short list of (parameter, count) pairs, white minus black. The loss and its gradient
+// over the whole dataset are then a sum of dot products, split across all cores.
+//
+// Usage: tune <dataset> [output header] [epochs] [threads]
+// Each dataset line is a FEN (or the first four FEN fields of an EPD line) followed by the game result
+// from white's point of view, as 1-0, 0-1, 1/2-1/2 or a number like [0.5].
+namespace tune {
+
+	// Parameter layout, each parameter has a midgame and an endgame value
+	constexpr int MATERIAL_OFFSET = 0;                     // pawn to queen
+	constexpr int PSQ_OFFSET = MATERIAL_OFFSET + 5;        // pawn to king, 64 squares each
+	constexpr int MOBILITY_OFFSET = PSQ_OFFSET + 6 * 64;   // knight to queen
+	constexpr int KING_ATTACK_OFFSET = MOBILITY_OFFSET + 4; // knight to queen
+	constexpr int PAWN_SHIELD_OFFSET = KING_ATTACK_OFFSET + 4;
+	constexpr int PARAM_COUNT = PAWN_SHIELD_OFFSET + 2;
+
+	constexpr int POSITIONS_PER_CHUNK = 1 << 14;
+	constexpr int SAVE_INTERVAL = 100;
+	constexpr double LEARNING_RATE = 1.0;
+
+	struct Feature {
+		uint16_t index;
+		int16_t count;
+	};
+
+	struct Position {
+		size_t begin;
+		uint16_t size;
+		uint8_t phase;
+		float result;
+	};
+
+	// Positions loaded by one thread. The loss is computed over the same split.
+	struct Shard {
+		std::vector<Position> positions;
+		std::vector<Feature> features;
+	};
+
+	struct Params {
+		std::array<double, PARAM_COUNT> mg = {};
+		std::array<double, PARAM_COUNT> eg = {};
+	};
+
+	static int pieceType(int piece) {
+		return piece > asInt(constants::Piece::wK) ? piece - asInt(constants::Piece::wK) : piece;
+	}
+
+	static Params currentParams() {
+		Params params;
+
+		for (int type = asInt(constants::Piece::wP); type <= asInt(constants::Piece::wQ); type++) {
+			params.mg[MATERIAL_OFFSET + type - 1] = constants::PIECE_VALUE_MG[type];
+			params.eg[MATERIAL_OFFSET + type - 1] = constants::PIECE_VALUE_EG[type];
+		}
+
+		for (int type = asInt(constants::Piece::wP); type <= asInt(constants::Piece::wK); type++) {
+			for (int square = 0; square < constants::SQUARES_AMOUNT; square++) {
+				params.mg[PSQ_OFFSET + (type - 1) * 64 + square] = constants::pieceSquareTableMg(type)[square];
+				params.eg[PSQ_OFFSET + (type - 1) * 64 + square] = constants::pieceSquareTableEg(type)[square];
+			}
+		}
+
+		for (int type = asInt(constants::Piece::wN); type <= asInt(constants::Piece::wQ); type++) {
+			params.mg[MOBILITY_OFFSET + type - 2] = constants::mgScore(constants::MOBILITY_SCORE[type]);
+			params.eg[MOBILITY_OFFSET + type - 2] = constants::egScore(constants::MOBILITY_SCORE[type]);
+			params.mg[KING_ATTACK_OFFSET + type - 2] = constants::mgScore(constants::KING_ATTACK_SCORE[type]);
+			params.eg[KING_ATTACK_OFFSET + type - 2] = constants::egScore(constants::KING_ATTACK_SCORE[type]);
+		}
+
+		for (int i = 0; i < 2; i++) {
+			params.mg[PAWN_SHIELD_OFFSET + i] = constants::mgScore(constants::PAWN_SHIELD_SCORE[i]);
+			params.eg[PAWN_SHIELD_OFFSET + i] = constants::egScore(constants::PAWN_SHIELD_SCORE[i]);
+		}
+
+		return params;
+	}
+
+	// Counts how often every parameter applies in the position, white minus black.
+	// This has to follow evaluate::evaluatePosition term by term, loadChunk checks that both agree.
+	static void extractFeatures(const board::BoardState& state, std::array<int, PARAM_COUNT>& counts) {
+		counts.fill(0);
+
+		for (int piece = asInt(constants::Piece::wP); piece <= asInt(constants::Piece::bK); piece++) {
+			bool is_white = constants::PIECE_COLOR[piece] == constants::Color::WHITE;
+			int sign = is_white ? 1 : -1;
+			int type = pieceType(piece);
+			int enemy_king = state.piece_list[is_white ? asInt(constants::Piece::bK) : asInt(constants::Piece::wK)][0];
+
+			for (int square : state.piece_list[piece]) {
+				int _64 = util::_120To64(square);
+
+				if (type != asInt(constants::Piece::wK))
+					counts[MATERIAL_OFFSET + type - 1] += sign;
+
+				counts[PSQ_OFFSET + (type - 1) * 64 + (is_white ? _64 : constants::MIRROR_SQUARE[_64])] += sign;
+
+				if (type >= asInt(constants::Piece::wN) && type <= asInt(constants::Piece::wQ)) {
+					int mobility;
+					int king_attacks;
+
+					evaluate::pieceActivity(state, static_cast<constants::Piece>(piece), square, enemy_king, mobility, king_attacks);
+
+					counts[MOBILITY_OFFSET + type - 2] += sign * (mobility - constants::MOBILITY_CENTER[piece]);
+					counts[KING_ATTACK_OFFSET + type - 2] += sign * king_attacks;
+				}
+			}
+		}
+
+		for (constants::Color color : { constants::Color::WHITE, constants::Color::BLACK }) {
+			int sign = color == constants::Color::WHITE ? 1 : -1;
+			int king = state.piece_list[color == constants::Color::WHITE ? asInt(constants::Piece::wK) : asInt(constants::Piece::bK)][0];
+			int pawn = color == constants::Color::WHITE ? asInt(constants::Piece::wP) : asInt(constants::Piece::bP);
+			int forward = color == constants::Color::WHITE ? constants::DIR_UP : constants::DIR_DOWN;
+
+			for (int side : { constants::DIR_LEFT, 0, constants::DIR_RIGHT }) {
+				if (state.pieces[king + forward + side] == pawn)
+					counts[PAWN_SHIELD_OFFSET] += sign;
+				else if (state.pieces[king + 2 * forward + side] == pawn)
+					counts[PAWN_SHIELD_OFFSET + 1] += sign;
+			}
+		}
+	}
+
+	// Evaluation from white's point of view as the tuner models it, with exact tapering
+	static double evaluate(const Params& params, const Feature* features, size_t size, int phase) {
+		double mg = 0;
+		double eg = 0;
+
+		for (size_t i = 0; i < size; i++) {
+			mg += params.mg[features[i].index] * features[i].count;
+			eg += params.eg[features[i].index] * features[i].count;
+		}
+
+		return (mg * phase + eg * (constants::TOTAL_PHASE - phase)) / constants::TOTAL_PHASE;
+	}
+
+	static double sigmoid(double k, double score) {
+		return 1.0 / (1.0 + std::exp(-k * score * std::log(10.0) / 400.0));
+	}
+
+	// Splits a dataset line into a six field FEN and the result, returns false for lines without a result
+	static bool parseLine(const std::string& line, std::string& fen, float& result) {
+		std::istringstream stream(line);
+		std::vector<std::string> fields;
+		std::string field;
+
+		for (int i = 0; i < 4 && stream >> field; i++)
+			fields.push_back(field);
+
+		if (fields.size() != 4)
+			return false;
+
+		std::string rest;
+		std::getline(stream, rest);
+
+		// EPD lines have no move counters
+		std::istringstream counters(rest);
+		std::string fifty_move;
+		std::string move_number;
+
+		if (counters >> fifty_move >> move_number && std::isdigit(fifty_move[0]) && std::isdigit(move_number[0]))
+			fen = fields[0] + " " + fields[1] + " " + fields[2] + " " + fields[3] + " " + fifty_move + " " + move_number;
+		else
+			fen = fields[0] + " " + fields[1] + " " + fields[2] + " " + fields[3] + " 0 1";
+
+		if (rest.find("1/2-1/2") != std::string::npos)
+			result = 0.5f;
+		else if (rest.find("1-0") != std::string::npos)
+			result = 1.0f;
+		else if (rest.find("0-1") != std::string::npos)
+			result = 0.0f;
+		else {
+			size_t open = rest.find('[');
+
+			if (open == std::string::npos)
+				return false;
+
+			try {
+				result = std::stof(rest.substr(open + 1));
+			}
+			catch (const std::logic_error&) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// Loads one chunk of lines into a shard, each thread has its own board and searcher
+	static void loadChunk(const std::vector<std::string>& lines, Shard& shard, long& skipped, int& max_error) {
+		board::BoardState state;
+		// the tables are not cleared between positions, entries of other positions never match their keys
+		search::Searcher searcher(1 << 16, 1 << 16, 0);
+		searcher.timeset = false;
+		// the line has to end in a quiet position, checks would leave it in one that isn't
+		searcher.qsearch_checks = false;
+		searcher.stopped = false;
+		searcher.nodes = 0;
+
+		std::array<int, PARAM_COUNT> counts;
+		Params params = currentParams();
+
+		for (const auto& line : lines) {
+			std::string fen;
+			float result = 0;
+
+			if (!parseLine(line, fen, result)) {
+				skipped++;
+				continue;
+			}
+
+			try {
+				state.loadFromFen(fen);
+			}
+			catch (const std::logic_error&) {
+				skipped++;
+				continue;
+			}
+
+			if (state.piece_list[asInt(constants::Piece::wK)].size() != 1 || state.piece_list[asInt(constants::Piece::bK)].size() != 1) {
+				skipped++;
+				continue;
+			}
+
+			// follow the quiescence search to a position without winning captures
+			searcher.quiesence(state, -constants::INFINITE_VAL, constants::INFINITE_VAL);
+			int count = searcher.table.getLine(state, search::MAX_DEPTH);
+			std::vector<move::Move> line_moves = state.pv_array;
+
+			for (int i = 0; i < count; i++)
+				state.step(line_moves[i]);
+
+			extractFeatures(state, counts);
+
+			Position position;
+			position.begin = shard.features.size();
+			position.phase = static_cast<uint8_t>(std::min(state.phase, constants::TOTAL_PHASE));
+			position.result = result;
+
+			for (int i = 0; i < PARAM_COUNT; i++) {
+				if (counts[i])
+					shard.features.push_back({ static_cast<uint16_t>(i), static_cast<int16_t>(counts[i]) });
+			}
+
+			position.size = static_cast<uint16_t>(shard.features.size() - position.begin);
+			shard.positions.push_back(position);
+
+			// the model has to reproduce the engine evaluation, up to the rounding of the tapering
+			int engine_score = evaluate::evaluatePosition(state);
+
+			if (state.player == constants::Color::BLACK)
+				engine_score = -engine_score;
+
+			double model_score = evaluate(params, &shard.features[position.begin], position.size, position.phase);
+			max_error = std::max(max_error, static_cast<int>(std::abs(model_score - engine_score)));
+		}
+	}
+
+	static std::vector<Shard> loadDataset(const std::string& path, int thread_count) {
+		std::vector<Shard> shards(thread_count);
+		std::ifstream file(path);
+
+		if (!file) {
+			std::cout << "Could not open " << path << std::endl;
+			return shards;
+		}
+
+		long loaded = 0;
+		long skipped = 0;
+		int max_error = 0;
+		long start_time = util::getTimeInMs();
+		bool done = false;
+
+		while (!done) {
+			std::vector<std::vector<std::string>> chunks(thread_count);
+
+			for (auto& chunk : chunks) {
+				std::string line;
+
+				while (chunk.size() < POSITIONS_PER_CHUNK && std::getline(file, line)) {
+					if (!line.empty())
+						chunk.push_back(line);
+				}
+
+				if (chunk.size() < POSITIONS_PER_CHUNK)
+					done = true;
+			}
+
+			std::vector<std::thread> threads;
+			std::vector<long> thread_skipped(thread_count, 0);
+			std::vector<int> thread_error(thread_count, 0);
+
+			for (int i = 0; i < thread_count; i++)
+				threads.emplace_back(loadChunk, std::cref(chunks[i]), std::ref(shards[i]), std::ref(thread_skipped[i]), std::ref(thread_error[i]));
+
+			for (int i = 0; i < thread_count; i++) {
+				threads[i].join();
+				loaded += chunks[i].size() - thread_skipped[i];
+				skipped += thread_skipped[i];
+				max_error = std::max(max_error, thread_error[i]);
+			}
+
+			std::cout << "Loaded " << loaded << " positions, skipped " << skipped << " (" << util::getTimeInMs() - start_time << " ms)" << std::endl;
+		}
+
+		if (max_error > 1)
+			std::cout << "Warning: the tuner model differs from the evaluation by up to " << max_error << ", extractFeatures is out of date" << std::endl;
+
+		return shards;
+	}
+
+	// Mean squared error over all positions. With a gradient given, it is filled with the derivatives by every parameter.
+	static double computeLoss(const std::vector<Shard>& shards, const Params& params, double k, Params* gradient) {
+		size_t thread_count = shards.size();
+		std::vector<double> losses(thread_count, 0);
+		std::vector<Params> gradients(gradient ? thread_count : 0);
+		std::vector<std::thread> threads;
+
+		for (size_t t = 0; t < thread_count; t++) {
+			threads.emplace_back([&, t]() {
+				const Shard& shard = shards[t];
+				double loss = 0;
+
+				for (const auto& position : shard.positions) {
+					const Feature* features = &shard.features[position.begin];
+					double score = evaluate(params, features, position.size, position.phase);
+					double probability = sigmoid(k, score);
+					double error = position.result - probability;
+
+					loss += error * error;
+
+					if (!gradient)
+						continue;
+
+					// d/dscore of (result - sigmoid)^2
+					double slope = -2.0 * error * probability * (1.0 - probability) * k * std::log(10.0) / 400.0;
+					double mg_weight = slope * position.phase / constants::TOTAL_PHASE;
+					double eg_weight = slope * (constants::TOTAL_PHASE - position.phase) / constants::TOTAL_PHASE;
+
+					for (size_t i = 0; i < position.size; i++) {
+						gradients[t].mg[features[i].index] += mg_weight * features[i].count;
+						gradients[t].eg[features[i].index] += eg_weight * features[i].count;
+					}
+				}
+
+				losses[t] = loss;
+			});
+		}
+
+		size_t position_count = 0;
+		double loss = 0;
+
+		for (size_t t = 0; t < thread_count; t++) {
+			threads[t].join();
+			loss += losses[t];
+			position_count += shards[t].positions.size();
+		}
+
+		if (gradient) {
+			*gradient = {};
+
+			for (const auto& thread_gradient : gradients) {
+				for (int i = 0; i < PARAM_COUNT; i++) {
+					gradient->mg[i] += thread_gradient.mg[i] / position_count;
+					gradient->eg[i] += thread_gradient.eg[i] / position_count;
+				}
+			}
+		}
+
+		return loss / position_count;
+	}
+
+	// Scaling of scores to win probabilities that fits the current evaluation best, by ternary search
+	static double fitK(const std::vector<Shard>& shards, const Params& params) {
+		double low = 0.0;
+		double high = 3.0;
+
+		for (int i = 0; i < 40; i++) {
+			double a = low + (high - low) / 3;
+			double b = high - (high - low) / 3;
+
+			if (computeLoss(shards, params, a, nullptr) < computeLoss(shards, params, b, nullptr))
+				high = b;
+			else
+				low = a;
+		}
+
+		return (low + high) / 2;
+	}
+
+	static std::string packed(double mg, double eg) {
+		return "makeScore(" + std::to_string(std::lround(mg)) + ", " + std::to_string(std::lround(eg)) + ")";
+	}
+
+	// Writes a per piece array, black pieces on a second line
+	static void writeArray13(std::ostream& out, const std::string& declaration, const std::array<std::string, 6>& values) {
+		std::string start = "    " + declaration + " = { ";
+		out << start << "0";
+
+		for (int type = 1; type <= 6; type++)
+			out << ", " << values[type - 1];
+
+		out << ",\n" << std::string(start.size(), ' ');
+
+		for (int type = 1; type <= 6; type++)
+			out << values[type - 1] << (type < 6 ? ", " : "");
+
+		out << " };\n";
+	}
+
+	static void writeTable(std::ostream& out, const std::string& name, const std::array<double, PARAM_COUNT>& values, int offset) {
+		out << "    constexpr std::array<int, 64> " << name << " = {\n";
+
+		for (int rank = 0; rank < 8; rank++) {
+			out << "    ";
+
+			for (int file = 0; file < 8; file++) {
+				int square = rank * 8 + file;
+				out << std::lround(values[offset + square]) << (file < 7 ? "\t,\t" : "");
+			}
+
+			out << (rank < 7 ? "\t,\n" : "\n");
+		}
+
+		out << "    };\n\n";
+	}
+
+	// Writes the tuned parameters as evalparams.hpp, which constants.hpp includes, so the output replaces that file as is
+	static bool writeHeader(const std::string& path, const Params& params, double loss, size_t position_count) {
+		std::ofstream out(path);
+
+		if (!out)
+			return false;
+
+		const char* PIECE_NAMES[6] = { "PAWN", "KNIGHT", "BISHOP", "ROOK", "QUEEN", "KING" };
+		std::array<std::string, 6> mg_values;
+		std::array<std::string, 6> eg_values;
+		std::array<std::string, 6> mobility;
+		std::array<std::string, 6> king_attacks;
+
+		for (int type = 1; type <= 6; type++) {
+			bool has_value = type <= asInt(constants::Piece::wQ);
+			bool is_mobile = type >= asInt(constants::Piece::wN) && type <= asInt(constants::Piece::wQ);
+
+			mg_values[type - 1] = has_value ? std::to_string(std::lround(params.mg[MATERIAL_OFFSET + type - 1])) : "0";
+			eg_values[type - 1] = has_value ? std::to_string(std::lround(params.eg[MATERIAL_OFFSET + type - 1])) : "0";
+			mobility[type - 1] = is_mobile ? packed(params.mg[MOBILITY_OFFSET + type - 2], params.eg[MOBILITY_OFFSET + type - 2]) : "0";
+			king_attacks[type - 1] = is_mobile ? packed(params.mg[KING_ATTACK_OFFSET + type - 2], params.eg[KING_ATTACK_OFFSET + type - 2]) : "0";
+		}
+
+		out << "#pragma once\n\n";
+		out << "#include <array>\n\n";
+		out << "// Generated by tune from " << position_count << " positions, loss " << std::setprecision(8) << loss << ".\n";
+		out << "// The evaluation parameters the tuner rewrites. Only constants.hpp includes this file, after makeScore.\n\n";
+		out << "namespace constants\n{\n\n";
+
+		writeArray13(out, "constexpr std::array<int, 13> PIECE_VALUE_MG", mg_values);
+		writeArray13(out, "constexpr std::array<int, 13> PIECE_VALUE_EG", eg_values);
+		out << "\n";
+		out << "    // Mobility is scored per reachable square, relative to the square count of an average placement\n";
+		writeArray13(out, "constexpr std::array<int, 13> MOBILITY_SCORE", mobility);
+		out << "\n";
+		out << "    // King safety: bonus per attacked square next to the enemy king, and for pawns one or two ranks in front of the own king\n";
+		writeArray13(out, "constexpr std::array<int, 13> KING_ATTACK_SCORE", king_attacks);
+		out << "    constexpr std::array<int, 2> PAWN_SHIELD_SCORE = { " << packed(params.mg[PAWN_SHIELD_OFFSET], params.eg[PAWN_SHIELD_OFFSET])
+			<< ", " << packed(params.mg[PAWN_SHIELD_OFFSET + 1], params.eg[PAWN_SHIELD_OFFSET + 1]) << " };\n\n";
+		out << "    // Piece-square tables from white's point of view, starting at A1\n\n";
+
+		for (int type = 0; type < 6; type++) {
+			writeTable(out, std::string(PIECE_NAMES[type]) + "_MG_TABLE", params.mg, PSQ_OFFSET + type * 64);
+			writeTable(out, std::string(PIECE_NAMES[type]) + "_EG_TABLE", params.eg, PSQ_OFFSET + type * 64);
+		}
+
+		out << "} // namespace constants\n";
+
+		return static_cast<bool>(out);
+	}
+
+	// Adam on the mean squared error. Pawns never stand on the first and last rank, so those entries keep a zero gradient.
+	static void tune(const std::vector<Shard>& shards, const std::string& output, int epochs) {
+		size_t position_count = 0;
+
+		for (const auto& shard : shards)
+			position_count += shard.positions.size();
+
+		if (!position_count) {
+			std::cout << "No positions to tune on" << std::endl;
+			return;
+		}
+
+		Params params = currentParams();
+		double k = fitK(shards, params);
+		std::cout << "K = " << k << ", initial loss " << std::setprecision(8) << computeLoss(shards, params, k, nullptr) << std::endl;
+
+		constexpr double BETA1 = 0.9;
+		constexpr double BETA2 = 0.999;
+		constexpr double EPSILON = 1e-8;
+
+		Params momentum;
+		Params velocity;
+		Params gradient;
+		double loss = 0;
+
+		for (int epoch = 1; epoch <= epochs; epoch++) {
+			loss = computeLoss(shards, params, k, &gradient);
+
+			double momentum_correction = 1.0 - std::pow(BETA1, epoch);
+			double velocity_correction = 1.0 - std::pow(BETA2, epoch);
+
+			auto step = [&](double& value, double grad, double& m, double& v) {
+				m = BETA1 * m + (1.0 - BETA1) * grad;
+				v = BETA2 * v + (1.0 - BETA2) * grad * grad;
+				value -= LEARNING_RATE * (m / momentum_correction) / (std::sqrt(v / velocity_correction) + EPSILON);
+			};
+
+			for (int i = 0; i < PARAM_COUNT; i++) {
+				step(params.mg[i], gradient.mg[i], momentum.mg[i], velocity.mg[i]);
+				step(params.eg[i], gradient.eg[i], momentum.eg[i], velocity.eg[i]);
+			}
+
+			if (epoch % 10 == 0)
+				std::cout << "Epoch " << epoch << " loss " << std::setprecision(8) << loss << std::endl;
+
+			if (epoch % SAVE_INTERVAL == 0 || epoch == epochs) {
+				if (!writeHeader(output, params, loss, position_count))
+					std::cout << "Could not write " << output << std::endl;
+			}
+		}
+
+		std::cout << "Final loss " << std::setprecision(8) << computeLoss(shards, params, k, nullptr) << ", written to " << output << std::endl;
+	}
+
+}
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		std::cout << "Usage: tune <dataset> [output header] [epochs] [threads]" << std::endl;
+		return 1;
+	}
+
+	std::string dataset = argv[1];
+	std::string output = argc > 2 ? argv[2] : "evalparams.hpp";
+	int epochs = argc > 3 ? std::stoi(argv[3]) : 1000;
+	int thread_count = argc > 4 ? std::stoi(argv[4]) : std::max(1u, std::thread::hardware_concurrency());
+
+	auto shards = tune::loadDataset(dataset, thread_count);
+	tune::tune(shards, output, epochs);
+
+	return 0;
+}
@@ -2,6 +2,9 @@
 
 #include <iostream>
 #include <stdexcept>
+#include <algorithm>
+#include <sstream>
+#include <vector>
 
 #include "board.hpp"
 #include "move.hpp"
@@ -9,15 +12,37 @@
 #include "attack.hpp"
 #include "util.hpp"
 #include "constants.hpp"
+#include "tablebase.hpp"
+#include "gensfen.hpp"
+#include "match.hpp"
+#include "batch.hpp"
+#include "threadbinding.hpp"
 
 namespace uci {
 
 
-	move::Move parseMove(board::BoardState& state, std::string move_string) {
-		auto moves = movegen::generateAllMoves(state);
+	// Decodes the squares and the promotion piece and looks them up in the generated moves,
+	// so no string is built per candidate
+	inline move::Move parseMove(board::BoardState& state, const std::string& move_string) {
+		auto validSquare = [&](size_t i) {
+			return move_string[i] >= 'a' && move_string[i] <= 'h' && move_string[i + 1] >= '1' && move_string[i + 1] <= '8';
+		};
 
-		for (const auto& move : moves) {
-			if (move.toString() == move_string)
+		if ((move_string.size() != 4 && move_string.size() != 5) || !validSquare(0) || !validSquare(2))
+			throw std::runtime_error("Invalid Move.");
+
+		int from = util::_120xyToSquare(move_string[0] - 'a', move_string[1] - '1');
+		int to = util::_120xyToSquare(move_string[2] - 'a', move_string[3] - '1');
+		char promotion = move_string.size() == 5 ? move_string[4] : ' ';
+
+		for (const auto& move : movegen::generateAllMoves(state)) {
+			if (move.from != from || move.to != to)
+				continue;
+
+			// promoted pieces 2..5 and 8..11 are knight to queen
+			char move_promotion = move.promoted_piece ? " nbrq"[(move.promoted_piece - 1) % 6] : ' ';
+
+			if (move_promotion == promotion)
 				return move;
 		}
 
@@ -25,17 +50,40 @@ namespace uci {
 	}
 
 	inline void parseGoCommand(std::string line, search::Searcher& searcher, board::BoardState& state) {
-		
+		searcher.stopSearch();
+
 		int depth = -1;
 		int remaining_moves = 30;
 		int movetime = -1;
 		int time = -1;
 		int increment = 0;
+		long node_limit = 0;
+		bool infinite = false;
+		bool ponder = false;
+		std::vector<move::Move> search_moves;
 		
 		auto parts = util::splitString(line, " ");
 
-		for (int i = 1; i < parts.size(); i += 2) {
-			if (parts[i] == "infinite") { ; }
+		// ponder and infinite take no value, searchmoves takes all following moves, every other token is followed by one value
+		for (size_t i = 1; i < parts.size(); i++) {
+			if (parts[i] == "infinite") { infinite = true; continue; }
+			if (parts[i] == "ponder") { ponder = true; continue; }
+
+			if (parts[i] == "searchmoves") {
+				while (i + 1 < parts.size()) {
+					try {
+						search_moves.push_back(parseMove(state, parts[i + 1]));
+						i++;
+					}
+					catch (const std::runtime_error&) {
+						break;
+					}
+				}
+				continue;
+			}
+
+			if (i + 1 >= parts.size())
+				break;
 
 			if (state.player == constants::Color::WHITE) {
 				if (parts[i] == "winc") { increment = std::stoi(parts[i + 1]); }
@@ -49,6 +97,20 @@ namespace uci {
 			if (parts[i] == "movestogo") { remaining_moves = std::stoi(parts[i + 1]); }
 			if (parts[i] == "movetime") { movetime = std::stoi(parts[i + 1]); }
 			if (parts[i] == "depth") { depth = std::stoi(parts[i + 1]); }
+			if (parts[i] == "nodes") { node_limit = std::stol(parts[i + 1]); }
+
+			i++;
+		}
+
+		// book moves are answered right away, without entering the search.
+		// A ponder search has to wait for ponderhit before answering, so it always searches.
+		if (!ponder && searcher.own_book && state.his_ply < searcher.book_depth * 2) {
+			move::Move book_move = searcher.book.probe(state, searcher.book_random);
+
+			if (!book_move.isNull()) {
+				std::cout << "bestmove " << book_move.toString() << std::endl;
+				return;
+			}
 		}
 
 		if (movetime != -1) {
@@ -58,12 +120,18 @@ namespace uci {
 
 		searcher.start_time = util::getTimeInMs();
 		searcher.depth = depth;
+		searcher.infinite = infinite;
+		searcher.pondering = ponder;
+		searcher.search_moves = search_moves;
+		searcher.node_limit = node_limit;
 
 		if (time != -1) {
 			searcher.timeset = true;
 			time /= remaining_moves;
 			time -= 50;
-			searcher.stop_time = searcher.start_time + time + increment;
+			// while pondering the clock only starts at ponderhit
+			searcher.time_allocated = time + increment;
+			searcher.stop_time = searcher.start_time + searcher.time_allocated;
 		}
 		else {
 			searcher.timeset = false;
@@ -73,66 +141,298 @@ namespace uci {
 			searcher.depth = 64;
 		}
 
-		std::cout << "time " << time << std::endl;
-		searcher.searchPosition(state);
+		searcher.startSearch(state);
 	}
 
-	inline void parsePositionCommand(std::string line, board::BoardState& state) {
-		auto parts = util::splitString(line, " ");
-		
+	// Position and moves of the last position command. A command that shares them plays only the moves that differ,
+	// GUIs resend the whole game before every move.
+	struct LastPosition {
+		std::string base;
+		std::vector<std::string> moves;
+	};
+
+	inline void parsePositionCommand(const std::string& line, board::BoardState& state, LastPosition& last) {
+		const std::string command_start = "position ";
+		size_t moves_start = line.find(" moves");
+		std::string base = line.size() > command_start.size() ? line.substr(command_start.size(), moves_start - std::min(moves_start, command_start.size())) : "";
+		std::vector<std::string> moves;
+
+		if (moves_start != std::string::npos) {
+			std::istringstream stream(line.substr(moves_start + 6));
+			std::string move_string;
+
+			while (stream >> move_string)
+				moves.push_back(move_string);
+		}
 
-		if (parts[1] == "startpos") {
-			state.loadFromFen(constants::FEN_START_POS);
+		size_t common = 0;
+
+		if (base == last.base) {
+			while (common < moves.size() && common < last.moves.size() && moves[common] == last.moves[common])
+				common++;
+
+			// moves taken back since the last command
+			for (size_t i = common; i < last.moves.size(); i++)
+				state.undo();
 		}
 		else {
 			try {
-				std::string only_fen = util::splitString(line, "position ")[1];
-				only_fen = util::splitString(only_fen, " moves ")[0];
-				state.loadFromFen(only_fen);
+				state.loadFromFen(base == "startpos" ? constants::FEN_START_POS : util::splitString(base, "fen ").back());
 			}
-			catch (std::invalid_argument) {
+			// the move counters go through std::stoi, which throws out_of_range for huge values
+			catch (const std::logic_error&) {
 				std::cout << "Invalid Fen" << std::endl;
 				state.reset();
+				last = {};
 				return;
 			}
+
+			last.base = base;
 		}
 
-		auto command_moves = util::splitString(line, "moves ");
-		if (command_moves.size() == 1)
+		last.moves.resize(common);
+
+		for (size_t i = common; i < moves.size(); i++) {
+			move::Move move;
+
+			try {
+				move = parseMove(state, moves[i]);
+			}
+			catch (const std::runtime_error&) {
+				std::cout << "info string Invalid move " << moves[i] << std::endl;
+				break;
+			}
+
+			if (!state.step(move)) {
+				std::cout << "info string Illegal move " << moves[i] << std::endl;
+				break;
+			}
+
+			last.moves.push_back(moves[i]);
+		}
+
+		state.ply = 0;
+	}
+
+	// gensfen [games n] [depth n] [nodes n] [threads n] [random_moves n] [max_plies n] [output file]
+	inline void parseGenSfenCommand(std::string line) {
+		gensfen::Options options;
+		bool depth_set = false;
+		auto parts = util::splitString(line, " ");
+
+		try {
+			for (size_t i = 1; i + 1 < parts.size(); i += 2) {
+				const std::string& value = parts[i + 1];
+
+				if (parts[i] == "games") { options.games = std::stol(value); }
+				else if (parts[i] == "depth") { options.depth = std::stoi(value); depth_set = true; }
+				else if (parts[i] == "nodes") { options.nodes = std::stol(value); }
+				else if (parts[i] == "threads") { options.threads = std::max(1, std::stoi(value)); }
+				else if (parts[i] == "random_moves") { options.random_moves = std::stoi(value); }
+				else if (parts[i] == "max_plies") { options.max_plies = std::stoi(value); }
+				else if (parts[i] == "output") { options.output = value; }
+				else { std::cout << "info string Unknown gensfen parameter " << parts[i] << std::endl; }
+			}
+		}
+		catch (const std::logic_error&) {
+			std::cout << "info string Invalid gensfen parameter" << std::endl;
 			return;
-		else if (command_moves.size() != 2) {
-			std::cout << "Invalid Command Format" << std::endl;
+		}
+
+		// a node limit alone searches as deep as the nodes allow
+		if (options.nodes && !depth_set)
+			options.depth = 0;
+
+		if (!gensfen::generate(options))
+			std::cout << "info string Could not write " << options.output << std::endl;
+	}
+
+	// match engine1 <path|self> engine2 <path|self> option1 Name=Value option2 Name=Value games 1000 concurrency 4 tc 10+0.1 openings book.epd elo0 0 elo1 5 alpha 0.05 beta 0.05
+	inline void parseMatchCommand(std::string line) {
+		match::Options options;
+		auto parts = util::splitString(line, " ");
+
+		try {
+			for (size_t i = 1; i + 1 < parts.size(); i += 2) {
+				const std::string& value = parts[i + 1];
+
+				if (parts[i] == "engine1") { options.engines[0].path = value; }
+				else if (parts[i] == "engine2") { options.engines[1].path = value; }
+				else if (parts[i] == "option1" || parts[i] == "option2") {
+					size_t separator = value.find('=');
+
+					if (separator == std::string::npos)
+						throw std::invalid_argument(value);
+
+					options.engines[parts[i] == "option1" ? 0 : 1].options.emplace_back(value.substr(0, separator), value.substr(separator + 1));
+				}
+				else if (parts[i] == "games") { options.games = std::stol(value); }
+				else if (parts[i] == "concurrency") { options.concurrency = std::max(1, std::stoi(value)); }
+				else if (parts[i] == "tc") {
+					// seconds, base+increment
+					auto time_control = util::splitString(value, "+");
+					options.base_time = static_cast<long>(std::stod(time_control[0]) * 1000);
+					options.increment = time_control.size() > 1 ? static_cast<long>(std::stod(time_control[1]) * 1000) : 0;
+				}
+				else if (parts[i] == "openings") { options.openings = value; }
+				else if (parts[i] == "elo0") { options.elo0 = std::stod(value); }
+				else if (parts[i] == "elo1") { options.elo1 = std::stod(value); }
+				else if (parts[i] == "alpha") { options.alpha = std::stod(value); }
+				else if (parts[i] == "beta") { options.beta = std::stod(value); }
+				else { std::cout << "info string Unknown match parameter " << parts[i] << std::endl; }
+			}
+		}
+		catch (const std::logic_error&) {
+			std::cout << "info string Invalid match parameter" << std::endl;
 			return;
 		}
-		
-		auto moves = util::splitString(command_moves[1], " ");
-		move::Move current_move;
 
-		for (const auto& move_str : moves) {
-			move::Move current_move = parseMove(state, move_str);
+		match::run(options);
+	}
 
-			if (current_move.isNull())
-				break;
+	// batch threads 4 depth 12 nodes 0 movetime 0 socket /tmp/engine.sock, followed by the positions (see batch.hpp)
+	inline void parseBatchCommand(std::string line) {
+		batch::Options options;
+		auto parts = util::splitString(line, " ");
+
+		try {
+			for (size_t i = 1; i + 1 < parts.size(); i += 2) {
+				const std::string& value = parts[i + 1];
 
-			std::cout << current_move.toString() << std::endl;
-			state.step(current_move);
+				if (parts[i] == "threads") { options.threads = std::max(1, std::stoi(value)); }
+				else if (parts[i] == "depth") { options.limits.depth = std::stoi(value); }
+				else if (parts[i] == "nodes") { options.limits.nodes = std::stol(value); }
+				else if (parts[i] == "movetime") { options.limits.movetime = std::stol(value); }
+				else if (parts[i] == "socket") { options.socket = value; }
+				else { std::cout << "info string Unknown batch parameter " << parts[i] << std::endl; }
+			}
+		}
+		catch (const std::logic_error&) {
+			std::cout << "info string Invalid batch parameter" << std::endl;
+			return;
 		}
 
-		state.ply = 0;
+		batch::run(options);
+	}
 
-		
+	inline void printOptions(const search::Searcher& searcher) {
+		std::cout << "option name Hash type spin default " << searcher.table.getMegabytes() << " min 1 max 65536" << std::endl;
+		std::cout << "option name HashFile type string default <empty>" << std::endl;
+		std::cout << "option name SaveHash type button" << std::endl;
+		std::cout << "option name LoadHash type button" << std::endl;
+		std::cout << "option name HashLearning type check default " << (searcher.hash_learning ? "true" : "false") << std::endl;
+		std::cout << "option name ThreadBinding type check default " << (threadbinding::isEnabled() ? "true" : "false") << std::endl;
+		std::cout << "option name Ponder type check default false" << std::endl;
+		std::cout << "option name QSearchChecks type check default " << (searcher.qsearch_checks ? "true" : "false") << std::endl;
+		std::cout << "option name MultiPV type spin default " << searcher.multi_pv << " min 1 max 256" << std::endl;
+		std::cout << "option name OwnBook type check default " << (searcher.own_book ? "true" : "false") << std::endl;
+		std::cout << "option name BookFile type string default <empty>" << std::endl;
+		std::cout << "option name BookDepth type spin default " << searcher.book_depth << " min 1 max 200" << std::endl;
+		std::cout << "option name BookRandom type check default " << (searcher.book_random ? "true" : "false") << std::endl;
+		std::cout << "option name SyzygyPath type string default <empty>" << std::endl;
+		std::cout << "option name SyzygyProbeDepth type spin default " << searcher.tb_probe_depth << " min 1 max 100" << std::endl;
+
+		if (stats::ENABLED)
+			std::cout << "option name StatsFile type string default <empty>" << std::endl;
+	}
+
+	inline void parseSetOptionCommand(std::string line, search::Searcher& searcher) {
+		auto name_parts = util::splitString(line, "name ");
+
+		if (name_parts.size() != 2) {
+			std::cout << "Invalid Command Format" << std::endl;
+			return;
+		}
+
+		auto value_parts = util::splitString(name_parts[1], " value ");
+		const std::string& name = value_parts[0];
+		std::string value = value_parts.size() > 1 ? value_parts[1] : "";
+
+		try {
+			if (name == "Hash") {
+				try {
+					searcher.table.setMegabytes(std::clamp(std::stoi(value), 1, 65536));
+				}
+				catch (const std::bad_alloc&) {
+					searcher.table.setMegabytes(1);
+					std::cout << "info string Not enough memory for Hash " << value << ", using 1 MB" << std::endl;
+				}
+			}
+			else if (name == "HashFile") {
+				searcher.hash_file = value == "<empty>" ? "" : value;
+			}
+			else if (name == "SaveHash") {
+				if (searcher.hash_file.empty() || !searcher.table.save(searcher.hash_file))
+					std::cout << "info string Could not save the hash to " << searcher.hash_file << std::endl;
+			}
+			else if (name == "LoadHash") {
+				if (searcher.hash_file.empty() || !searcher.table.load(searcher.hash_file, searcher.hash_learning))
+					std::cout << "info string Could not load the hash from " << searcher.hash_file << std::endl;
+			}
+			else if (name == "HashLearning") {
+				searcher.hash_learning = value == "true";
+			}
+			else if (name == "ThreadBinding") {
+				threadbinding::setEnabled(value == "true");
+			}
+			else if (name == "Ponder") {
+				// nothing to set up, the GUI decides when to send go ponder
+			}
+			else if (name == "QSearchChecks") {
+				searcher.qsearch_checks = value == "true";
+			}
+			else if (name == "MultiPV") {
+				searcher.multi_pv = std::clamp(std::stoi(value), 1, 256);
+			}
+			else if (name == "OwnBook") {
+				searcher.own_book = value == "true";
+			}
+			else if (name == "BookFile") {
+				if (value.empty() || value == "<empty>")
+					searcher.book.close();
+				else if (!searcher.book.open(value))
+					std::cout << "info string Could not open book " << value << std::endl;
+			}
+			else if (name == "BookDepth") {
+				searcher.book_depth = std::clamp(std::stoi(value), 1, 200);
+			}
+			else if (name == "BookRandom") {
+				searcher.book_random = value == "true";
+			}
+			else if (name == "SyzygyPath") {
+				tablebase::init(value);
+			}
+			else if (name == "SyzygyProbeDepth") {
+				searcher.tb_probe_depth = std::clamp(std::stoi(value), 1, 100);
+			}
+			else if (name == "StatsFile" && stats::ENABLED) {
+				searcher.stats_file = value == "<empty>" ? "" : value;
+			}
+			else {
+				std::cout << "info string Unknown option " << name << std::endl;
+			}
+		}
+		// std::stoi throws out_of_range before a too large spin value can be clamped
+		catch (const std::logic_error&) {
+			std::cout << "info string Invalid value for option " << name << std::endl;
+		}
 	}
 
 	inline void uciLoop() {
 		std::string input;
 
 		board::BoardState state = board::BoardState();
-		search::Searcher searcher = search::Searcher(1000000*4, 10);
+		LastPosition last_position;
+		search::Searcher searcher = search::Searcher(1000000*4, 1000000, 10);
 
 
 		while(true) {
 
-			std::getline(std::cin, input);
+			// end of input: let a running search finish, then quit
+			if (!std::getline(std::cin, input)) {
+				searcher.waitForSearch();
+				break;
+			}
 
 			if (input.empty())
 				continue;
@@ -146,28 +446,56 @@ namespace uci {
 			if (command == "isready") {
 				std::cout << "readyok" << std::endl;
 			}
+			else if (command == "stop") {
+				searcher.stopSearch();
+			}
+			else if (command == "ponderhit") {
+				searcher.ponderHit();
+			}
+			else if (command == "debug") {
+				// read by the search thread when it finishes
+				searcher.debug = parts.size() > 1 && parts[1] == "on";
+			}
 			else if(command == "position") {
-				parsePositionCommand(input, state);
-				std::cout << state.toString() << std::endl;
+				searcher.stopSearch();
+				parsePositionCommand(input, state, last_position);
 			}
 			else if (command == "ucinewgame") {
-				parsePositionCommand("position startpos", state);
+				searcher.stopSearch();
+				searcher.history.clear();
+				searcher.table.clear();
+				last_position = {};
+				parsePositionCommand("position startpos", state, last_position);
 			}
 			else if (command == "quit") {
-				searcher.quit = true;
+				searcher.stopSearch();
 				break;
 			}
+			else if (command == "setoption") {
+				searcher.stopSearch();
+				parseSetOptionCommand(input, searcher);
+			}
 			else if (command == "go") {
 				parseGoCommand(input, searcher, state);
 			}
+			else if (command == "gensfen") {
+				searcher.stopSearch();
+				parseGenSfenCommand(input);
+			}
+			else if (command == "match") {
+				searcher.stopSearch();
+				parseMatchCommand(input);
+			}
+			else if (command == "batch") {
+				searcher.stopSearch();
+				parseBatchCommand(input);
+			}
 			else if (command == "uci") {
 				std::cout << "id name " << constants::NAME << std::endl;
 				std::cout << "id author " << constants::AUTHOR << std::endl;
+				printOptions(searcher);
 				std::cout << "uciok" << std::endl;
 			}
-
-			if (searcher.quit)
-				break;
 		
 		}
 		
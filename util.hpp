@@ -16,7 +16,7 @@ namespace util
     #include "time.h"
     #endif
     constexpr int getCapturePriority(constants::Piece attacker, constants::Piece victim) {
-        return constants::PIECE_VALUE[asInt(victim)] - constants::PIECE_VALUE[asInt(attacker)];
+        return constants::CAPTURE_ORDER_VALUE[asInt(victim)] - constants::CAPTURE_ORDER_VALUE[asInt(attacker)];
     }
 
     constexpr long getTimeInMs() {
@@ -99,43 +99,5 @@ namespace util
     }
 
 
-    // Code from Olithink
-    inline int inputWaiting()
-    {
-#ifndef WIN32
-        fd_set readfds;
-        struct timeval tv;
-        FD_ZERO(&readfds);
-        FD_SET(fileno(stdin), &readfds);
-        tv.tv_sec = 0; tv.tv_usec = 0;
-        select(16, &readfds, 0, 0, &tv);
-
-        return (FD_ISSET(fileno(stdin), &readfds));
-#else
-        static int init = 0, pipe;
-        static HANDLE inh;
-        DWORD dw;
-
-        if (!init) {
-            init = 1;
-            inh = GetStdHandle(STD_INPUT_HANDLE);
-            pipe = !GetConsoleMode(inh, &dw);
-            if (!pipe) {
-                SetConsoleMode(inh, dw & ~(ENABLE_MOUSE_INPUT | ENABLE_WINDOW_INPUT));
-                FlushConsoleInputBuffer(inh);
-            }
-        }
-        if (pipe) {
-            if (!PeekNamedPipe(inh, NULL, 0, NULL, &dw, NULL)) return 1;
-            return dw;
-        }
-        else {
-            GetNumberOfConsoleInputEvents(inh, &dw);
-            return dw <= 1 ? 0 : dw;
-        }
-#endif
-    }
-
-
 
 } // namespace util
\ No newline at end of file